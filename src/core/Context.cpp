@@ -16,7 +16,15 @@
 #include <dlfcn.h>
 #endif
 
+#if defined(_WIN32)
+#include <malloc.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <mutex>
+#include <thread>
 
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/DebugInfo.h"
@@ -40,23 +48,300 @@
 using namespace oclgrind;
 using namespace std;
 
+// Set while the current thread runs a work-group without instrumentation
+// Errors from such a work-group can be deferred, so that it can be replayed
+// with instrumentation to diagnose them
+static THREAD_LOCAL bool uninstrumented = false;
+static THREAD_LOCAL bool deferErrors = false;
+static THREAD_LOCAL bool deferredErrors = false;
+
+// Events that can be delivered to plugins asynchronously
+static bool isAsyncEvent(Plugin::Event event)
+{
+  switch (event)
+  {
+  case Plugin::EventInstructionExecuted:
+  case Plugin::EventMemoryAtomicLoad:
+  case Plugin::EventMemoryAtomicStore:
+  case Plugin::EventMemoryLoad:
+  case Plugin::EventMemoryStore:
+    return true;
+  default:
+    return false;
+  }
+}
+
+struct Context::WorkerPool
+{
+  std::mutex mutex;
+  std::mutex runMutex;
+  std::condition_variable start;
+  std::condition_variable done;
+  std::vector<std::thread> threads;
+
+  // Current job
+  std::function<void(unsigned)> func;
+  unsigned numActive;
+  unsigned numRemaining;
+  uint64_t generation;
+  bool shutdown;
+
+  void worker(unsigned id);
+};
+
+void Context::WorkerPool::worker(unsigned id)
+{
+  uint64_t seen = 0;
+  unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    start.wait(lock, [&]{ return shutdown || generation != seen; });
+    if (shutdown)
+      break;
+    seen = generation;
+
+    // Pool may be larger than the current job needs
+    if (id >= numActive)
+      continue;
+
+    lock.unlock();
+    func(id);
+    lock.lock();
+
+    if (--numRemaining == 0)
+      done.notify_one();
+  }
+}
+
+// Number of events held by each asynchronous event ring
+#define ASYNC_RING_SIZE (1<<16) // Must be power of two
+
+#define CACHE_LINE_SIZE 64
+
+struct Context::AsyncPipeline
+{
+  // Lock-free ring with a single producer (a worker) and a single consumer
+  // (the analysis thread that owns it)
+  // The producer and consumer indices are kept on separate cache lines, and
+  // rings are allocated on cache line boundaries so that they do not share
+  // lines with each other
+  struct alignas(CACHE_LINE_SIZE) Ring
+  {
+    std::vector<Plugin::AsyncEvent> events;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail;
+
+    size_t drain(const std::vector<Plugin*>& plugins);
+
+    // Plain operator new does not respect over-alignment before C++17
+    static void* operator new(size_t size);
+    static void operator delete(void *ptr);
+  };
+  std::vector<Ring*> rings;
+
+  // Analysis threads, kept alive between kernel invocations and woken for
+  // each kernel
+  std::mutex mutex;
+  std::condition_variable start;
+  std::condition_variable done;
+  std::vector<std::thread> threads;
+  const std::vector<Plugin*> *plugins;
+  unsigned numActive;
+  unsigned numRemaining;
+  uint64_t generation;
+  bool shutdown;
+  std::atomic<bool> stop;
+
+  void analyse(unsigned first, unsigned stride);
+  void worker(unsigned id);
+};
+
+void* Context::AsyncPipeline::Ring::operator new(size_t size)
+{
+  void *ptr;
+#if defined(_WIN32)
+  ptr = _aligned_malloc(size, CACHE_LINE_SIZE);
+#else
+  if (posix_memalign(&ptr, CACHE_LINE_SIZE, size))
+    ptr = NULL;
+#endif
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void Context::AsyncPipeline::Ring::operator delete(void *ptr)
+{
+#if defined(_WIN32)
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+size_t Context::AsyncPipeline::Ring::drain(const vector<Plugin*>& plugins)
+{
+  size_t t = tail.load(memory_order_relaxed);
+  size_t h = head.load(memory_order_acquire);
+  if (h == t)
+    return 0;
+
+  // Pass events to plugins in (up to two) contiguous runs
+  size_t begin = t & (ASYNC_RING_SIZE-1);
+  size_t num = h - t;
+  size_t first = min(num, (size_t)ASYNC_RING_SIZE - begin);
+  for (Plugin *plugin : plugins)
+  {
+    plugin->asyncEvents(events.data() + begin, first);
+    if (num > first)
+      plugin->asyncEvents(events.data(), num - first);
+  }
+
+  tail.store(h, memory_order_release);
+  return num;
+}
+
+void Context::AsyncPipeline::analyse(unsigned first, unsigned stride)
+{
+  unsigned idle = 0;
+  while (true)
+  {
+    // Check for stop before draining, so that the last events are seen
+    bool stopping = stop.load(memory_order_acquire);
+
+    size_t num = 0;
+    for (unsigned r = first; r < rings.size(); r += stride)
+      num += rings[r]->drain(*plugins);
+
+    if (num)
+    {
+      idle = 0;
+      continue;
+    }
+    if (stopping)
+      break;
+
+    // Back off while workers are not producing events
+    if (++idle < 64)
+      this_thread::yield();
+    else
+      this_thread::sleep_for(chrono::microseconds(100));
+  }
+}
+
+void Context::AsyncPipeline::worker(unsigned id)
+{
+  uint64_t seen = 0;
+  unique_lock<std::mutex> lock(mutex);
+  while (true)
+  {
+    start.wait(lock, [&]{ return shutdown || generation != seen; });
+    if (shutdown)
+      break;
+    seen = generation;
+
+    // Pool may be larger than the current kernel needs
+    if (id >= numActive)
+      continue;
+
+    lock.unlock();
+    analyse(id, numActive);
+    lock.lock();
+
+    if (--numRemaining == 0)
+      done.notify_one();
+  }
+}
+
 Context::Context()
 {
   m_llvmContext = new llvm::LLVMContext;
 
+  m_numWorkers = getEnvInt("OCLGRIND_NUM_THREADS",
+                           thread::hardware_concurrency(), false);
+  if (!m_numWorkers)
+    m_numWorkers = 1;
+
+  m_workerPool = new WorkerPool;
+  m_workerPool->numActive = 0;
+  m_workerPool->numRemaining = 0;
+  m_workerPool->generation = 0;
+  m_workerPool->shutdown = false;
+
   m_globalMemory = new Memory(AddrSpaceGlobal, sizeof(size_t)==8 ? 16 : 8,
                               this);
   m_kernelInvocation = NULL;
 
+  m_asyncPipeline = NULL;
+  if (checkEnv("OCLGRIND_ASYNC_PLUGINS"))
+  {
+    m_asyncPipeline = new AsyncPipeline;
+    m_asyncPipeline->plugins = &m_asyncSubscribers;
+    m_asyncPipeline->numActive = 0;
+    m_asyncPipeline->numRemaining = 0;
+    m_asyncPipeline->generation = 0;
+    m_asyncPipeline->shutdown = false;
+  }
+
   loadPlugins();
+  updateSubscriptions();
 }
 
 Context::~Context()
 {
+  // Stop worker threads
+  {
+    lock_guard<mutex> lock(m_workerPool->mutex);
+    m_workerPool->shutdown = true;
+  }
+  m_workerPool->start.notify_all();
+  for (thread& t : m_workerPool->threads)
+  {
+    t.join();
+  }
+  delete m_workerPool;
+
+  // Stop analysis threads
+  if (m_asyncPipeline)
+  {
+    {
+      lock_guard<mutex> lock(m_asyncPipeline->mutex);
+      m_asyncPipeline->shutdown = true;
+    }
+    m_asyncPipeline->start.notify_all();
+    for (thread& t : m_asyncPipeline->threads)
+    {
+      t.join();
+    }
+  }
+
   delete m_llvmContext;
   delete m_globalMemory;
+  m_globalMemory = NULL;
 
   unloadPlugins();
+
+  if (m_asyncPipeline)
+  {
+    for (AsyncPipeline::Ring *ring : m_asyncPipeline->rings)
+      delete ring;
+    delete m_asyncPipeline;
+  }
+}
+
+unsigned Context::getNumWorkers() const
+{
+  return m_numWorkers;
+}
+
+bool Context::hasDeferredErrors() const
+{
+  return deferredErrors;
+}
+
+bool Context::isInstrumented() const
+{
+  return !uninstrumented;
 }
 
 bool Context::isThreadSafe() const
@@ -69,6 +354,109 @@ bool Context::isThreadSafe() const
   return true;
 }
 
+bool Context::needsInstructionEvents() const
+{
+  return m_needsInstructionEvents;
+}
+
+void Context::runWorkers(unsigned numWorkers,
+                         function<void(unsigned)> func) const
+{
+  // Run single workers on the calling thread
+  if (numWorkers <= 1)
+  {
+    func(0);
+    return;
+  }
+
+  lock_guard<mutex> runLock(m_workerPool->runMutex);
+  {
+    lock_guard<mutex> lock(m_workerPool->mutex);
+
+    // Create additional threads as needed, the calling thread is worker 0
+    while (m_workerPool->threads.size() < numWorkers-1)
+    {
+      unsigned id = m_workerPool->threads.size() + 1;
+      m_workerPool->threads.push_back(
+        thread(&WorkerPool::worker, m_workerPool, id));
+    }
+
+    m_workerPool->func = func;
+    m_workerPool->numActive = numWorkers;
+    m_workerPool->numRemaining = numWorkers-1;
+    m_workerPool->generation++;
+  }
+  m_workerPool->start.notify_all();
+
+  func(0);
+
+  // Wait for other workers to finish
+  unique_lock<mutex> lock(m_workerPool->mutex);
+  m_workerPool->done.wait(lock, [&]{ return !m_workerPool->numRemaining; });
+  m_workerPool->func = nullptr;
+}
+
+void Context::setInstrumented(bool instrumented, bool defer) const
+{
+  uninstrumented = !instrumented;
+  deferErrors = !instrumented && defer;
+  deferredErrors = false;
+}
+
+void Context::setNumWorkers(unsigned numWorkers)
+{
+  m_numWorkers = numWorkers ? numWorkers : 1;
+}
+
+void Context::startAsyncAnalysis() const
+{
+  // One ring per worker
+  vector<AsyncPipeline::Ring*>& rings = m_asyncPipeline->rings;
+  while (rings.size() < m_numWorkers)
+  {
+    AsyncPipeline::Ring *ring = new AsyncPipeline::Ring;
+    ring->events.resize(ASYNC_RING_SIZE);
+    rings.push_back(ring);
+  }
+  for (AsyncPipeline::Ring *ring : rings)
+  {
+    ring->head = 0;
+    ring->tail = 0;
+  }
+  m_asyncPipeline->stop = false;
+
+  // Use the remaining hardware threads for analysis
+  unsigned numThreads = thread::hardware_concurrency();
+  numThreads = numThreads > m_numWorkers ? numThreads - m_numWorkers : 1;
+  numThreads = min(numThreads, (unsigned)rings.size());
+
+  {
+    lock_guard<mutex> lock(m_asyncPipeline->mutex);
+
+    // Create additional threads as needed
+    while (m_asyncPipeline->threads.size() < numThreads)
+    {
+      unsigned id = m_asyncPipeline->threads.size();
+      m_asyncPipeline->threads.push_back(
+        thread(&AsyncPipeline::worker, m_asyncPipeline, id));
+    }
+
+    m_asyncPipeline->numActive = numThreads;
+    m_asyncPipeline->numRemaining = numThreads;
+    m_asyncPipeline->generation++;
+  }
+  m_asyncPipeline->start.notify_all();
+}
+
+void Context::stopAsyncAnalysis() const
+{
+  // Wait for analysis threads to drain the remaining events
+  m_asyncPipeline->stop = true;
+  unique_lock<mutex> lock(m_asyncPipeline->mutex);
+  m_asyncPipeline->done.wait(lock,
+                             [&]{ return !m_asyncPipeline->numRemaining; });
+}
+
 Memory* Context::getGlobalMemory() const
 {
   return m_globalMemory;
@@ -179,16 +567,130 @@ void Context::unloadPlugins()
   }
 
   m_plugins.clear();
+  updateSubscriptions();
+}
+
+void Context::recordAsyncEvent(int event, const WorkItem *workItem,
+                               const WorkGroup *workGroup,
+                               const Memory *memory, size_t address,
+                               size_t size, AtomicOp op) const
+{
+  AsyncPipeline::Ring *ring =
+    m_asyncPipeline->rings[m_kernelInvocation->getWorkerID()];
+
+  // Wait for the analysis thread if the ring is full
+  size_t h = ring->head.load(memory_order_relaxed);
+  while (h - ring->tail.load(memory_order_acquire) >= ASYNC_RING_SIZE)
+    this_thread::yield();
+
+  Plugin::AsyncEvent& e = ring->events[h & (ASYNC_RING_SIZE-1)];
+  e.event = (Plugin::Event)event;
+  e.instruction = workItem ? workItem->getCurrentInstruction() : NULL;
+  e.memory = memory;
+  e.address = address;
+  e.size = size;
+  e.op = op;
+  e.workGroup = workGroup->getGroupIndex();
+  e.workItem = workItem ? workItem->getGlobalIndex() : -1;
+
+  ring->head.store(h+1, memory_order_release);
+}
+
+unsigned Context::allocatePluginIndex() const
+{
+  lock_guard<mutex> lock(m_pluginIndexMutex);
+
+  // Use the lowest free index, so that data slots stay small
+  unsigned index = 0;
+  while (index < m_pluginIndices.size() && m_pluginIndices[index])
+    index++;
+  if (index == m_pluginIndices.size())
+    m_pluginIndices.push_back(true);
+  else
+    m_pluginIndices[index] = true;
+  return index;
 }
 
 void Context::registerPlugin(Plugin *plugin)
 {
   m_plugins.push_back(make_pair(plugin, false));
+  updateSubscriptions();
+}
+
+void Context::releasePluginIndex(unsigned index) const
+{
+  lock_guard<mutex> lock(m_pluginIndexMutex);
+
+  // Clear data left in global memory, so that it cannot be mistaken for
+  // data of the next plugin to use this index
+  if (m_globalMemory)
+    m_globalMemory->clearPluginData(index);
+  m_pluginIndices[index] = false;
 }
 
 void Context::unregisterPlugin(Plugin *plugin)
 {
   m_plugins.remove(make_pair(plugin, false));
+  updateSubscriptions();
+}
+
+void Context::updateSubscriptions()
+{
+  m_subscribers.assign(Plugin::NumEvents, vector<Plugin*>());
+  m_instructionSubscribers.assign(llvm::Instruction::OtherOpsEnd,
+                                  vector<Plugin*>());
+  m_needsInstructionEvents = false;
+
+  m_asyncSubscribers.clear();
+  m_asyncEvents.assign(Plugin::NumEvents, false);
+  m_asyncInstructions.assign(llvm::Instruction::OtherOpsEnd, false);
+
+  // Size the data slots of global memory up front, as they are shared
+  // between worker threads and are not resized safely while in use
+  if (m_globalMemory)
+  {
+    lock_guard<mutex> lock(m_pluginIndexMutex);
+    m_globalMemory->resizePluginData(m_pluginIndices.size());
+  }
+
+  for (const PluginEntry &p : m_plugins)
+  {
+    Plugin *plugin = p.first;
+
+    bool async = m_asyncPipeline && plugin->supportsAsyncEvents();
+    if (async)
+      m_asyncSubscribers.push_back(plugin);
+
+    bool needsInstructions = false;
+    for (unsigned event = 0; event < Plugin::NumEvents; event++)
+    {
+      if (!plugin->needsEvent((Plugin::Event)event))
+        continue;
+
+      if (event == Plugin::EventInstructionExecuted)
+        needsInstructions = true;
+      else if (async && isAsyncEvent((Plugin::Event)event))
+        m_asyncEvents[event] = true;
+      else
+        m_subscribers[event].push_back(plugin);
+    }
+
+    if (!needsInstructions)
+      continue;
+
+    for (unsigned opcode = 0; opcode < llvm::Instruction::OtherOpsEnd;
+         opcode++)
+    {
+      if (plugin->needsInstruction(opcode))
+      {
+        if (async)
+          m_asyncInstructions[opcode] = true;
+        else
+          m_instructionSubscribers[opcode].push_back(plugin);
+        m_needsInstructionEvents = true;
+      }
+    }
+  }
 }
 
 void Context::logError(const char* error) const
@@ -202,21 +704,49 @@ void Context::logError(const char* error) const
   msg.send();
 }
 
-#define NOTIFY(function, ...)                     \
-{                                                 \
-  PluginList::const_iterator pluginItr;           \
-  for (pluginItr = m_plugins.begin();             \
-       pluginItr != m_plugins.end(); pluginItr++) \
-  {                                               \
-    pluginItr->first->function(__VA_ARGS__);      \
-  }                                               \
+#define NOTIFY_SUBSCRIBERS(subscribers, function, ...) \
+{                                                      \
+  for (Plugin *plugin : subscribers)                   \
+  {                                                    \
+    plugin->function(__VA_ARGS__);                     \
+  }                                                    \
 }
 
+#define NOTIFY(event, function, ...) \
+  NOTIFY_SUBSCRIBERS(m_subscribers[Plugin::event], function, __VA_ARGS__)
+
+// Events raised while running work-groups are not passed on to plugins
+// when running an unsampled work-group without instrumentation
+#define NOTIFY_INSTRUMENTED(event, function, ...) \
+  if (!uninstrumented)                            \
+    NOTIFY(event, function, __VA_ARGS__)
+
+// Invalid accesses are still detected when errors are being deferred
+#define CHECK_DEFERRED_ACCESS(memory, address, size)          \
+  if (deferErrors && !memory->isAddressValid(address, size)) \
+    deferredErrors = true
+
+// Memory events from work-items (or work-groups) are also recorded for
+// asynchronous plugins
+#define RECORD_ASYNC(event, workItem, workGroup, ...)                    \
+  if (!uninstrumented && m_asyncEvents[Plugin::event])                 \
+    recordAsyncEvent(Plugin::event, workItem, workGroup, __VA_ARGS__)
+
 void Context::notifyInstructionExecuted(const WorkItem *workItem,
                                         const llvm::Instruction *instruction,
                                         const TypedValue& result) const
 {
-  NOTIFY(instructionExecuted, workItem, instruction, result);
+  if (!uninstrumented)
+  {
+    unsigned opcode = instruction->getOpcode();
+    NOTIFY_SUBSCRIBERS(m_instructionSubscribers[opcode],
+                       instructionExecuted, workItem, instruction, result);
+    if (m_asyncInstructions[opcode])
+    {
+      recordAsyncEvent(Plugin::EventInstructionExecuted, workItem,
+                       workItem->getWorkGroup(), NULL, 0, 0);
+    }
+  }
 }
 
 void Context::notifyKernelBegin(const KernelInvocation *kernelInvocation) const
@@ -224,12 +754,19 @@ void Context::notifyKernelBegin(const KernelInvocation *kernelInvocation) const
   assert(m_kernelInvocation == NULL);
   m_kernelInvocation = kernelInvocation;
 
-  NOTIFY(kernelBegin, kernelInvocation);
+  NOTIFY(EventKernelBegin, kernelBegin, kernelInvocation);
+
+  if (!m_asyncSubscribers.empty())
+    startAsyncAnalysis();
 }
 
 void Context::notifyKernelEnd(const KernelInvocation *kernelInvocation) const
 {
-  NOTIFY(kernelEnd, kernelInvocation);
+  // Deliver all outstanding events before the kernel is finished
+  if (!m_asyncSubscribers.empty())
+    stopAsyncAnalysis();
+
+  NOTIFY(EventKernelEnd, kernelEnd, kernelInvocation);
 
   assert(m_kernelInvocation == kernelInvocation);
   m_kernelInvocation = NULL;
@@ -239,54 +776,76 @@ void Context::notifyMemoryAllocated(const Memory *memory, size_t address,
                                     size_t size, cl_mem_flags flags,
                                     const uint8_t *initData) const
 {
-  NOTIFY(memoryAllocated, memory, address, size, flags, initData);
+  NOTIFY_INSTRUMENTED(EventMemoryAllocated, memoryAllocated,
+                      memory, address, size, flags, initData);
 }
 
 void Context::notifyMemoryAtomicLoad(const Memory *memory, AtomicOp op,
                                      size_t address, size_t size) const
 {
+  CHECK_DEFERRED_ACCESS(memory, address, size);
+
   if (m_kernelInvocation && m_kernelInvocation->getCurrentWorkItem())
   {
-    NOTIFY(memoryAtomicLoad, memory, m_kernelInvocation->getCurrentWorkItem(),
-           op, address, size);
+    const WorkItem *workItem = m_kernelInvocation->getCurrentWorkItem();
+    NOTIFY_INSTRUMENTED(EventMemoryAtomicLoad, memoryAtomicLoad, memory,
+                        workItem, op, address, size);
+    RECORD_ASYNC(EventMemoryAtomicLoad, workItem, workItem->getWorkGroup(),
+                 memory, address, size, op);
   }
 }
 
 void Context::notifyMemoryAtomicStore(const Memory *memory, AtomicOp op,
                                       size_t address, size_t size) const
 {
+  CHECK_DEFERRED_ACCESS(memory, address, size);
+
   if (m_kernelInvocation && m_kernelInvocation->getCurrentWorkItem())
   {
-    NOTIFY(memoryAtomicStore, memory, m_kernelInvocation->getCurrentWorkItem(),
-           op, address, size);
+    if (uninstrumented && memory == m_globalMemory)
+      m_kernelInvocation->recordStore(address, size);
+
+    const WorkItem *workItem = m_kernelInvocation->getCurrentWorkItem();
+    NOTIFY_INSTRUMENTED(EventMemoryAtomicStore, memoryAtomicStore, memory,
+                        workItem, op, address, size);
+    RECORD_ASYNC(EventMemoryAtomicStore, workItem, workItem->getWorkGroup(),
+                 memory, address, size, op);
   }
 }
 
 void Context::notifyMemoryDeallocated(const Memory *memory,
                                       size_t address) const
 {
-  NOTIFY(memoryDeallocated, memory, address);
+  NOTIFY_INSTRUMENTED(EventMemoryDeallocated, memoryDeallocated,
+                      memory, address);
 }
 
 void Context::notifyMemoryLoad(const Memory *memory, size_t address,
                                size_t size) const
 {
+  CHECK_DEFERRED_ACCESS(memory, address, size);
+
   if (m_kernelInvocation)
   {
     if (m_kernelInvocation->getCurrentWorkItem())
     {
-      NOTIFY(memoryLoad, memory, m_kernelInvocation->getCurrentWorkItem(),
-             address, size);
+      const WorkItem *workItem = m_kernelInvocation->getCurrentWorkItem();
+      NOTIFY_INSTRUMENTED(EventMemoryLoad, memoryLoad, memory,
+                          workItem, address, size);
+      RECORD_ASYNC(EventMemoryLoad, workItem, workItem->getWorkGroup(),
+                   memory, address, size);
     }
     else if (m_kernelInvocation->getCurrentWorkGroup())
     {
-      NOTIFY(memoryLoad, memory, m_kernelInvocation->getCurrentWorkGroup(),
-             address, size);
+      const WorkGroup *workGroup = m_kernelInvocation->getCurrentWorkGroup();
+      NOTIFY_INSTRUMENTED(EventMemoryLoad, memoryLoad, memory,
+                          workGroup, address, size);
+      RECORD_ASYNC(EventMemoryLoad, NULL, workGroup, memory, address, size);
     }
   }
   else
   {
-    NOTIFY(hostMemoryLoad, memory, address, size);
+    NOTIFY(EventHostMemoryLoad, hostMemoryLoad, memory, address, size);
   }
 }
 
@@ -294,69 +853,97 @@ void Context::notifyMemoryMap(const Memory *memory, size_t address,
                               size_t offset, size_t size,
                               cl_mem_flags flags) const
 {
-  NOTIFY(memoryMap, memory, address, offset, size, flags);
+  NOTIFY(EventMemoryMap, memoryMap, memory, address, offset, size, flags);
 }
 
 void Context::notifyMemoryStore(const Memory *memory, size_t address,
                                 size_t size, const uint8_t *storeData) const
 {
+  CHECK_DEFERRED_ACCESS(memory, address, size);
+
+  // Stores made outside a work-item or work-group (such as those reported
+  // after replaying a kernel) are treated as host stores
+  const WorkItem *workItem = NULL;
+  const WorkGroup *workGroup = NULL;
   if (m_kernelInvocation)
   {
-    if (m_kernelInvocation->getCurrentWorkItem())
-    {
-      NOTIFY(memoryStore, memory, m_kernelInvocation->getCurrentWorkItem(),
-             address, size, storeData);
-    }
-    else if (m_kernelInvocation->getCurrentWorkGroup())
-    {
-      NOTIFY(memoryStore, memory, m_kernelInvocation->getCurrentWorkGroup(),
-             address, size, storeData);
-    }
+    workItem = m_kernelInvocation->getCurrentWorkItem();
+    workGroup = m_kernelInvocation->getCurrentWorkGroup();
+    if ((workItem || workGroup) && uninstrumented && memory == m_globalMemory)
+      m_kernelInvocation->recordStore(address, size);
+  }
+
+  if (workItem)
+  {
+    NOTIFY_INSTRUMENTED(EventMemoryStore, memoryStore, memory,
+                        workItem, address, size, storeData);
+    RECORD_ASYNC(EventMemoryStore, workItem, workItem->getWorkGroup(),
+                 memory, address, size);
+  }
+  else if (workGroup)
+  {
+    NOTIFY_INSTRUMENTED(EventMemoryStore, memoryStore, memory,
+                        workGroup, address, size, storeData);
+    RECORD_ASYNC(EventMemoryStore, NULL, workGroup, memory, address, size);
   }
   else
   {
-    NOTIFY(hostMemoryStore, memory, address, size, storeData);
+    NOTIFY(EventHostMemoryStore, hostMemoryStore,
+           memory, address, size, storeData);
   }
 }
 
 void Context::notifyMessage(MessageType type, const char *message) const
 {
-  NOTIFY(log, type, message);
+  // Errors are dropped and flag the work-group to be replayed, which will
+  // raise them again with plugins attached
+  if (deferErrors && type == ERROR)
+  {
+    deferredErrors = true;
+    return;
+  }
+
+  NOTIFY(EventLog, log, type, message);
 }
 
 void Context::notifyMemoryUnmap(const Memory *memory, size_t address,
                                 const void *ptr) const
 {
-  NOTIFY(memoryUnmap, memory, address, ptr);
+  NOTIFY(EventMemoryUnmap, memoryUnmap, memory, address, ptr);
 }
 
 void Context::notifyWorkGroupBarrier(const WorkGroup *workGroup,
                                      uint32_t flags) const
 {
-  NOTIFY(workGroupBarrier, workGroup, flags);
+  NOTIFY_INSTRUMENTED(EventWorkGroupBarrier, workGroupBarrier,
+                      workGroup, flags);
 }
 
 void Context::notifyWorkGroupBegin(const WorkGroup *workGroup) const
 {
-  NOTIFY(workGroupBegin, workGroup);
+  NOTIFY_INSTRUMENTED(EventWorkGroupBegin, workGroupBegin, workGroup);
 }
 
 void Context::notifyWorkGroupComplete(const WorkGroup *workGroup) const
 {
-  NOTIFY(workGroupComplete, workGroup);
+  NOTIFY_INSTRUMENTED(EventWorkGroupComplete, workGroupComplete, workGroup);
 }
 
 void Context::notifyWorkItemBegin(const WorkItem *workItem) const
 {
-  NOTIFY(workItemBegin, workItem);
+  NOTIFY_INSTRUMENTED(EventWorkItemBegin, workItemBegin, workItem);
 }
 
 void Context::notifyWorkItemComplete(const WorkItem *workItem) const
 {
-  NOTIFY(workItemComplete, workItem);
+  NOTIFY_INSTRUMENTED(EventWorkItemComplete, workItemComplete, workItem);
 }
 
+#undef NOTIFY_SUBSCRIBERS
 #undef NOTIFY
+#undef NOTIFY_INSTRUMENTED
+#undef RECORD_ASYNC
+#undef CHECK_DEFERRED_ACCESS
 
 
 Context::Message::Message(MessageType type, const Context *context)
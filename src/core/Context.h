@@ -8,6 +8,9 @@
 
 #include "common.h"
 
+#include <functional>
+#include <mutex>
+
 namespace llvm
 {
   class LLVMContext;
@@ -32,8 +35,16 @@ namespace oclgrind
 
     Memory* getGlobalMemory() const;
     llvm::LLVMContext* getLLVMContext() const;
+    unsigned getNumWorkers() const;
+    bool hasDeferredErrors() const;
+    bool isInstrumented() const;
     bool isThreadSafe() const;
     void logError(const char* error) const;
+    bool needsInstructionEvents() const;
+    void runWorkers(unsigned numWorkers,
+                    std::function<void(unsigned)> func) const;
+    void setInstrumented(bool instrumented, bool deferErrors=false) const;
+    void setNumWorkers(unsigned numWorkers);
 
     // Simulation callbacks
     void notifyInstructionExecuted(const WorkItem *workItem,
@@ -67,7 +78,9 @@ namespace oclgrind
 
 
     // Plugins
+    unsigned allocatePluginIndex() const;
     void registerPlugin(Plugin *plugin);
+    void releasePluginIndex(unsigned index) const;
     void unregisterPlugin(Plugin *plugin);
 
   private:
@@ -79,8 +92,39 @@ namespace oclgrind
     void loadPlugins();
     void unloadPlugins();
 
+    // Plugin data slot indices in use, which are reused once released
+    mutable std::mutex m_pluginIndexMutex;
+    mutable std::vector<bool> m_pluginIndices;
+
+    // Plugins subscribed to each event, and to instructionExecuted for each
+    // opcode, so that events without subscribers cost a single branch
+    std::vector< std::vector<Plugin*> > m_subscribers;
+    std::vector< std::vector<Plugin*> > m_instructionSubscribers;
+    bool m_needsInstructionEvents;
+    void updateSubscriptions();
+
+    // In asynchronous mode, instruction and memory events for plugins that
+    // support it are recorded into a ring per worker, and consumed by
+    // analysis threads while the kernel runs
+    struct AsyncPipeline;
+    AsyncPipeline *m_asyncPipeline;
+    std::vector<Plugin*> m_asyncSubscribers;
+    std::vector<bool> m_asyncEvents;
+    std::vector<bool> m_asyncInstructions;
+    void recordAsyncEvent(int event, const WorkItem *workItem,
+                          const WorkGroup *workGroup, const Memory *memory,
+                          size_t address, size_t size,
+                          AtomicOp op = AtomicAdd) const;
+    void startAsyncAnalysis() const;
+    void stopAsyncAnalysis() const;
+
     llvm::LLVMContext *m_llvmContext;
 
+    // Worker threads, kept alive between kernel invocations
+    unsigned m_numWorkers;
+    struct WorkerPool;
+    WorkerPool *m_workerPool;
+
   public:
     class Message
     {
@@ -8,9 +8,15 @@
 
 #include "common.h"
 
+#include <algorithm>
 #include <atomic>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <random>
 #include <sstream>
-#include <thread>
+
+#include "llvm/IR/Module.h"
 
 #include "Context.h"
 #include "Kernel.h"
@@ -30,7 +36,147 @@ struct
   WorkItem  *workItem;
 } static THREAD_LOCAL workerState;
 
-static atomic<unsigned> nextGroupIndex;
+// Target execution time for each chunk of work-groups claimed by a worker
+static const double CHUNK_TIME_NS = 1e6;
+
+struct KernelInvocation::Worker
+{
+  // Unclaimed positions owned by this worker
+  // Only modified while holding the lock, but may be read without it
+  mutex lock;
+  atomic<size_t> begin;
+  atomic<size_t> end;
+
+  // Positions claimed for execution, only accessed by the owner
+  size_t next;
+  size_t chunkEnd;
+
+  // Moving average of work-group execution time in nanoseconds
+  double groupTime;
+
+  // Finished work-group kept to be reset for the next group, only accessed
+  // by the owner
+  WorkGroup *spareGroup;
+
+  // Global memory ranges stored without plugins in the first pass of replay
+  // mode, and the first range stored by the current work-group
+  vector< pair<size_t,size_t> > stores;
+  size_t groupStores;
+
+  // Statistics
+  size_t numWorkGroups;
+  size_t numChunks;
+  size_t numSteals;
+  chrono::steady_clock::duration overhead;
+};
+
+// Choose k of n indices in one dimension: both edges, then one random index
+// from each equally sized stratum of the interior
+static vector<size_t> sampleDimension(size_t n, size_t k, mt19937_64& rng)
+{
+  vector<size_t> samples;
+  if (k >= n)
+  {
+    for (size_t i = 0; i < n; i++)
+      samples.push_back(i);
+    return samples;
+  }
+
+  samples.push_back(0);
+  if (k > 1)
+  {
+    size_t interior = n - 2;
+    size_t strata = k - 2;
+    for (size_t s = 0; s < strata; s++)
+    {
+      size_t lo = 1 + (interior*s)/strata;
+      size_t hi = 1 + (interior*(s+1))/strata;
+      samples.push_back(uniform_int_distribution<size_t>(lo, hi-1)(rng));
+    }
+    samples.push_back(n-1);
+  }
+  return samples;
+}
+
+// Choose a stratified sample of work-groups, returned as sorted linear
+// indices, where sample is either a fraction or a number of work-groups
+static vector<size_t> sampleWorkGroups(Size3 numGroups, double sample,
+                                       unsigned seed)
+{
+  size_t total = numGroups.x * numGroups.y * numGroups.z;
+  double fraction = sample < 1 ? sample : min(sample/total, 1.0);
+
+  // Split fraction evenly across dimensions with more than one group
+  unsigned dims = 0;
+  for (unsigned d = 0; d < 3; d++)
+    dims += numGroups[d] > 1;
+  double perDim = dims ? pow(fraction, 1.0/dims) : 1.0;
+
+  mt19937_64 rng(seed);
+  vector<size_t> samples[3];
+  for (unsigned d = 0; d < 3; d++)
+  {
+    size_t k = llround(numGroups[d]*perDim);
+    samples[d] = sampleDimension(numGroups[d], max<size_t>(k, 1), rng);
+  }
+
+  vector<size_t> groups;
+  for (size_t k : samples[2])
+  {
+    for (size_t j : samples[1])
+    {
+      for (size_t i : samples[0])
+      {
+        groups.push_back(i + (j + k*numGroups.y)*numGroups.x);
+      }
+    }
+  }
+  return groups;
+}
+
+// Get the addresses of global memory buffers that a kernel can write to,
+// through non-const global pointer arguments, writable image arguments and
+// program scope variables
+static set<size_t> getWritableBuffers(const Kernel *kernel)
+{
+  set<size_t> addresses;
+  for (auto value = kernel->values_begin();
+            value != kernel->values_end();
+            value++)
+  {
+    const llvm::Type *type = value->first->getType();
+    if (!type->isPointerTy() ||
+        type->getPointerAddressSpace() != AddrSpaceGlobal)
+      continue;
+
+    if (auto arg = llvm::dyn_cast<llvm::Argument>(value->first))
+    {
+      unsigned index = arg->getArgNo();
+      if (kernel->getArgumentTypeQualifier(index) & CL_KERNEL_ARG_TYPE_CONST)
+        continue;
+
+      // Only image arguments have an access qualifier, and they point to a
+      // descriptor for the image data
+      unsigned access = kernel->getArgumentAccessQualifier(index);
+      if (access == CL_KERNEL_ARG_ACCESS_READ_ONLY)
+        continue;
+      if (access == CL_KERNEL_ARG_ACCESS_WRITE_ONLY ||
+          access == CL_KERNEL_ARG_ACCESS_READ_WRITE)
+      {
+        addresses.insert((*(Image**)value->second.data)->address);
+        continue;
+      }
+    }
+    else if (auto var = llvm::dyn_cast<llvm::GlobalVariable>(value->first))
+    {
+      if (var->isConstant())
+        continue;
+    }
+
+    addresses.insert(value->second.getPointer());
+  }
+  return addresses;
+}
 
 KernelInvocation::KernelInvocation(const Context *context, const Kernel *kernel,
                                    unsigned int workDim,
@@ -54,39 +200,63 @@ KernelInvocation::KernelInvocation(const Context *context, const Kernel *kernel,
     m_numGroups.z += m_globalSize.z % m_localSize.z ? 1 : 0;
   }
 
-  // Check for user overriding number of threads
-  m_numWorkers = getEnvInt("OCLGRIND_NUM_THREADS",
-                           thread::hardware_concurrency(), false);
-  if (!m_numWorkers || !m_context->isThreadSafe())
+  // Use the context's worker threads, unless plugins are not thread-safe
+  m_numWorkers = m_context->getNumWorkers();
+  if (!m_context->isThreadSafe())
     m_numWorkers = 1;
 
+  bool interactive = checkEnv("OCLGRIND_INTERACTIVE");
+
+  // Work-items can share a single interpreter state if they run to
+  // completion one at a time without synchronizing with the rest of the group
+  const InterpreterCache *cache =
+    kernel->getProgram()->getInterpreterCache(kernel->getFunction());
+  m_recycleWorkItems = !interactive && !cache->usesWorkGroupSync();
+
   // Check for quick-mode environment variable
+  // Only run first and last work-groups in quick-mode
+  m_numWorkGroups = m_numGroups.x * m_numGroups.y * m_numGroups.z;
   if (checkEnv("OCLGRIND_QUICK"))
   {
-    // Only run first and last work-groups in quick-mode
-    Size3 firstGroup(0, 0, 0);
-    Size3 lastGroup(m_numGroups.x-1, m_numGroups.y-1, m_numGroups.z-1);
-    m_workGroups.push_back(firstGroup);
-    if (lastGroup != firstGroup)
-      m_workGroups.push_back(lastGroup);
+    m_sampledGroups.push_back(0);
+    if (m_numWorkGroups > 1)
+      m_sampledGroups.push_back(m_numWorkGroups-1);
   }
-  else
+  else if (getenv("OCLGRIND_SAMPLE"))
   {
-    for (size_t k = 0; k < m_numGroups.z; k++)
+    // Sample a fraction or a number of work-groups
+    const char *value = getenv("OCLGRIND_SAMPLE");
+    char *next;
+    double sample = strtod(value, &next);
+    if (strlen(next) || !(sample > 0))
     {
-      for (size_t j = 0; j < m_numGroups.y; j++)
-      {
-        for (size_t i = 0; i < m_numGroups.x; i++)
-        {
-          m_workGroups.push_back(Size3(i, j, k));
-        }
-      }
+      cerr << endl << "Oclgrind: Invalid value for OCLGRIND_SAMPLE" << endl;
+      abort();
     }
+
+    unsigned seed = getEnvInt("OCLGRIND_SAMPLE_SEED", 0);
+    m_sampledGroups = sampleWorkGroups(m_numGroups, sample, seed);
   }
+
+  // Check for replay mode, where work-groups first run without plugins
+  // and only those that raise errors are run again with plugins attached
+  m_replay = checkEnv("OCLGRIND_REPLAY") && !interactive;
+  m_recordFlaggedGroups = false;
+  m_replaying = false;
+
+  // Optionally run every work-group, but only instrument sampled ones
+  m_sampleUninstrumented = !m_sampledGroups.empty() && !interactive &&
+                           !m_replay &&
+                           checkEnv("OCLGRIND_SAMPLE_UNINSTRUMENTED");
+  if (!m_sampledGroups.empty() && !m_sampleUninstrumented)
+    m_numWorkGroups = m_sampledGroups.size();
 }
 
 KernelInvocation::~KernelInvocation()
 {
+  for (Worker *worker : m_workers)
+    delete worker;
+
   // Destroy any remaining work-groups
   while (!m_runningGroups.empty())
   {
@@ -95,6 +265,11 @@ KernelInvocation::~KernelInvocation()
   }
 }
 
+bool KernelInvocation::canRecycleWorkItems() const
+{
+  return m_recycleWorkItems;
+}
+
 const Context* KernelInvocation::getContext() const
 {
   return m_context;
@@ -140,6 +315,25 @@ size_t KernelInvocation::getWorkDim() const
   return m_workDim;
 }
 
+void KernelInvocation::recordStore(size_t address, size_t size) const
+{
+  if (!m_recordFlaggedGroups)
+    return;
+
+  // Merge with the previous range stored by this work-group if contiguous
+  Worker *worker = m_workers[workerState.id];
+  vector< pair<size_t,size_t> >& stores = worker->stores;
+  if (stores.size() > worker->groupStores &&
+      stores.back().first + stores.back().second == address)
+  {
+    stores.back().second += size;
+  }
+  else
+  {
+    stores.push_back(make_pair(address, size));
+  }
+}
+
 void KernelInvocation::run(const Context *context, Kernel *kernel,
                            unsigned int workDim,
                            Size3 globalOffset,
@@ -162,21 +356,134 @@ void KernelInvocation::run(const Context *context, Kernel *kernel,
 
 void KernelInvocation::run()
 {
-  nextGroupIndex = 0;
-
-  // Create worker threads
-  // TODO: Run in main thread if only 1 worker
-  vector<thread> threads;
   for (unsigned i = 0; i < m_numWorkers; i++)
   {
-    threads.push_back(thread(&KernelInvocation::runWorker, this, i));
+    Worker *worker = new Worker;
+    worker->groupTime = 0;
+    worker->spareGroup = NULL;
+    worker->groupStores = 0;
+    worker->numWorkGroups = 0;
+    worker->numChunks = 0;
+    worker->numSteals = 0;
+    worker->overhead = chrono::steady_clock::duration::zero();
+    m_workers.push_back(worker);
+  }
+
+  if (!m_replay)
+  {
+    runWorkGroups();
+    return;
+  }
+
+  // Run every work-group without plugins, keeping a copy of the inputs
+  // to the buffers that the kernel can write to
+  Memory *globalMemory = m_context->getGlobalMemory();
+  Memory::Snapshot snapshot;
+  globalMemory->createSnapshot(snapshot, getWritableBuffers(m_kernel));
+  m_recordFlaggedGroups = true;
+  runWorkGroups();
+  m_recordFlaggedGroups = false;
+
+  if (!m_flaggedGroups.empty())
+  {
+    // Replay work-groups that raised errors from the original inputs with
+    // plugins attached, then restore the results of the first run
+    globalMemory->swapSnapshot(snapshot);
+    sort(m_flaggedGroups.begin(), m_flaggedGroups.end());
+    m_sampledGroups = m_flaggedGroups;
+    m_numWorkGroups = m_sampledGroups.size();
+    m_replaying = true;
+    runWorkGroups();
+    m_replaying = false;
+    globalMemory->swapSnapshot(snapshot);
+  }
+
+  // Plugins did not see the stores made by work-groups that were not
+  // replayed, so report their results as host stores
+  // Their shadow state is lost, so these results count as initialized
+  for (Worker *worker : m_workers)
+  {
+    for (auto& store : worker->stores)
+    {
+      const uint8_t *data =
+        (const uint8_t*)globalMemory->mapBuffer(store.first, 0, store.second);
+      m_context->notifyMemoryStore(globalMemory, store.first, store.second,
+                                   data);
+    }
   }
+}
 
-  // Wait for workers to complete
+void KernelInvocation::runWorkGroups()
+{
+  // Divide work-groups evenly between workers
   for (unsigned i = 0; i < m_numWorkers; i++)
   {
-    threads[i].join();
+    Worker *worker = m_workers[i];
+    worker->begin = (m_numWorkGroups * i) / m_numWorkers;
+    worker->end = (m_numWorkGroups * (i+1)) / m_numWorkers;
+    worker->next = worker->begin;
+    worker->chunkEnd = worker->begin;
   }
+  m_startedGroups.clear();
+
+  // Run workers on the context's thread pool
+  m_context->runWorkers(m_numWorkers, [this](unsigned id){ runWorker(id); });
+
+  // Destroy spare work-groups before the kernel ends
+  for (Worker *worker : m_workers)
+  {
+    delete worker->spareGroup;
+    worker->spareGroup = NULL;
+  }
+}
+
+size_t KernelInvocation::getWorkGroupIndex(size_t position) const
+{
+  // Map position in the run order to a linear work-group index
+  if (m_sampledGroups.empty() || m_sampleUninstrumented)
+    return position;
+  return m_sampledGroups[position];
+}
+
+bool KernelInvocation::claimChunk(Worker *worker)
+{
+  lock_guard<mutex> lock(worker->lock);
+
+  size_t remaining = worker->end - worker->begin;
+  if (!remaining)
+    return false;
+
+  // Aim for a fixed execution time per chunk, but leave at least half of
+  // the remaining work-groups available for other workers to steal
+  size_t chunk = 1;
+  if (worker->groupTime > 0)
+    chunk = max<size_t>(CHUNK_TIME_NS / worker->groupTime, 1);
+  chunk = min(chunk, max<size_t>(remaining/2, 1));
+
+  worker->next = worker->begin;
+  worker->chunkEnd = worker->begin + chunk;
+  worker->begin += chunk;
+  worker->numChunks++;
+  return true;
+}
+
+KernelInvocation::SchedulerStats KernelInvocation::getSchedulerStats() const
+{
+  SchedulerStats stats = {0, 0, 0, 0.0};
+  for (const Worker *worker : m_workers)
+  {
+    stats.numWorkGroups += worker->numWorkGroups;
+    stats.numChunks += worker->numChunks;
+    stats.numSteals += worker->numSteals;
+    stats.overhead +=
+      chrono::duration_cast<chrono::duration<double>>(worker->overhead).count();
+  }
+  return stats;
+}
+
+bool KernelInvocation::isReplaying() const
+{
+  return m_replaying;
 }
 
 int KernelInvocation::getWorkerID() const
@@ -184,8 +491,25 @@ int KernelInvocation::getWorkerID() const
   return workerState.id;
 }
 
+bool KernelInvocation::nextWorkGroup(Worker *worker, size_t& position)
+{
+  if (worker->next >= worker->chunkEnd)
+  {
+    auto start = chrono::steady_clock::now();
+    bool claimed = claimChunk(worker) ||
+                   (stealWork(worker) && claimChunk(worker));
+    worker->overhead += chrono::steady_clock::now() - start;
+    if (!claimed)
+      return false;
+  }
+
+  position = worker->next++;
+  return true;
+}
+
 void KernelInvocation::runWorker(int id)
 {
+  Worker *worker = m_workers[id];
   workerState.workGroup = NULL;
   workerState.workItem = NULL;
   workerState.id = id;
@@ -203,12 +527,30 @@ void KernelInvocation::runWorker(int id)
       else
       {
         // Take next work-group from pending pool
-        unsigned index = nextGroupIndex++;
-        if (index >= m_workGroups.size())
+        size_t position;
+        if (!nextWorkGroup(worker, position))
           // No more work to do
           break;
 
-        Size3 wgid   = m_workGroups[index];
+        // Skip work-groups that were already started by switchWorkItem
+        size_t index = getWorkGroupIndex(position);
+        if (!m_startedGroups.empty() && m_startedGroups.count(index))
+          continue;
+
+        // Only notify plugins about sampled work-groups
+        if (m_sampleUninstrumented)
+        {
+          m_context->setInstrumented(binary_search(m_sampledGroups.begin(),
+                                                   m_sampledGroups.end(),
+                                                   index));
+        }
+        else if (m_recordFlaggedGroups)
+        {
+          m_context->setInstrumented(false, true);
+          worker->groupStores = worker->stores.size();
+        }
+
+        Size3 wgid   = Size3(index, m_numGroups);
         Size3 wgsize = m_localSize;
 
         // Handle remainder work-groups
@@ -218,9 +560,20 @@ void KernelInvocation::runWorker(int id)
             wgsize[i] = m_globalSize[i] % wgsize[i];
         }
 
-        workerState.workGroup = new WorkGroup(this, wgid, wgsize);
+        if (worker->spareGroup)
+        {
+          // Reuse the last work-group run by this worker
+          workerState.workGroup = worker->spareGroup;
+          worker->spareGroup = NULL;
+          workerState.workGroup->reset(wgid, wgsize);
+        }
+        else
+        {
+          workerState.workGroup = new WorkGroup(this, wgid, wgsize);
+        }
         m_context->notifyWorkGroupBegin(workerState.workGroup);
       }
+      auto groupStart = chrono::steady_clock::now();
 
       // Execute work-group
       workerState.workItem = workerState.workGroup->getNextWorkItem();
@@ -247,14 +600,44 @@ void KernelInvocation::runWorker(int id)
         }
       }
 
-      // Work-group has finished
+      // Work-group has finished, so release its local memory while it is
+      // still the current group
       m_context->notifyWorkGroupComplete(workerState.workGroup);
-      delete workerState.workGroup;
+      workerState.workGroup->release();
+
+      // Record work-groups that need to be replayed with plugins attached
+      if (m_recordFlaggedGroups && m_context->hasDeferredErrors())
+      {
+        Size3 wgid = workerState.workGroup->getGroupID();
+        lock_guard<mutex> lock(m_flaggedGroupsMutex);
+        m_flaggedGroups.push_back(
+          wgid.x + (wgid.y + wgid.z*m_numGroups.y)*m_numGroups.x);
+
+        // Plugins will see this work-group's stores when it is replayed
+        worker->stores.resize(worker->groupStores);
+      }
+
+      if (worker->spareGroup)
+        delete workerState.workGroup;
+      else
+        worker->spareGroup = workerState.workGroup;
       workerState.workGroup = NULL;
+
+      // Update average work-group execution time used to size chunks
+      double groupTime = chrono::duration<double, nano>(
+        chrono::steady_clock::now() - groupStart).count();
+      if (worker->groupTime > 0)
+        worker->groupTime = 0.75*worker->groupTime + 0.25*groupTime;
+      else
+        worker->groupTime = groupTime;
+      worker->numWorkGroups++;
     }
   }
   catch (FatalError& err)
   {
+    // Always report fatal errors immediately
+    m_context->setInstrumented(true);
+
     ostringstream info;
     info << "OCLGRIND FATAL ERROR "
          << "(" << err.getFile() << ":" << err.getLine() << ")"
@@ -264,6 +647,49 @@ void KernelInvocation::runWorker(int id)
     if (workerState.workGroup)
       delete workerState.workGroup;
   }
+
+  // Restore instrumentation for other uses of this thread
+  m_context->setInstrumented(true);
+}
+
+bool KernelInvocation::stealWork(Worker *worker)
+{
+  while (true)
+  {
+    // Choose the worker with the most unclaimed work-groups
+    Worker *victim = NULL;
+    size_t most = 0;
+    for (Worker *other : m_workers)
+    {
+      size_t remaining = other->end - other->begin;
+      if (other != worker && remaining > most)
+      {
+        victim = other;
+        most = remaining;
+      }
+    }
+    if (!victim)
+      return false;
+
+    // Take the back half of its range
+    size_t begin, end;
+    {
+      lock_guard<mutex> lock(victim->lock);
+      size_t remaining = victim->end - victim->begin;
+      if (!remaining)
+        continue;
+
+      end = victim->end;
+      begin = end - (remaining+1)/2;
+      victim->end = begin;
+    }
+
+    lock_guard<mutex> lock(worker->lock);
+    worker->begin = begin;
+    worker->end = end;
+    worker->numSteals++;
+    return true;
+  }
 }
 
 bool KernelInvocation::switchWorkItem(const Size3 gid)
@@ -301,24 +727,23 @@ bool KernelInvocation::switchWorkItem(const Size3 gid)
   // Check if work-group is in pending pool
   if (!found)
   {
-    std::vector<Size3>::iterator pItr;
-    for (pItr = m_workGroups.begin()+nextGroupIndex;
-         pItr != m_workGroups.end(); pItr++)
+    size_t index = group.x + (group.y + group.z*m_numGroups.y)*m_numGroups.x;
+    size_t position = index;
+    if (!m_sampledGroups.empty() && !m_sampleUninstrumented)
+    {
+      position = lower_bound(m_sampledGroups.begin(), m_sampledGroups.end(),
+                             index) - m_sampledGroups.begin();
+    }
+    if (position >= m_workers[0]->next && position < m_numWorkGroups &&
+        getWorkGroupIndex(position) == index && !m_startedGroups.count(index))
     {
-     if (group == *pItr)
-     {
-       workerState.workGroup = new WorkGroup(this, group);
-       m_context->notifyWorkGroupBegin(workerState.workGroup);
-       found = true;
-
-       // Re-order list of groups accordingly
-       // Safe since this is not in a multi-threaded context
-       m_workGroups.erase(pItr);
-       m_workGroups.insert(m_workGroups.begin()+nextGroupIndex, group);
-       nextGroupIndex++;
-
-       break;
-     }
+      workerState.workGroup = new WorkGroup(this, group);
+      m_context->notifyWorkGroupBegin(workerState.workGroup);
+      found = true;
+
+      // Record that the group has started so that it is skipped later
+      // Safe since this is not in a multi-threaded context
+      m_startedGroups.insert(index);
     }
   }
 
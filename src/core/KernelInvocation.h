@@ -8,6 +8,9 @@
 
 #include "common.h"
 
+#include <mutex>
+#include <unordered_set>
+
 namespace oclgrind
 {
   class Context;
@@ -33,10 +36,23 @@ namespace oclgrind
     const Kernel* getKernel() const;
     Size3 getNumGroups() const;
     size_t getWorkDim() const;
+    bool isReplaying() const;
+    void recordStore(size_t address, size_t size) const;
     bool switchWorkItem(const Size3 gid);
+    bool canRecycleWorkItems() const;
 
     int getWorkerID() const;
 
+    // Scheduler statistics, summed over all workers
+    struct SchedulerStats
+    {
+      size_t numWorkGroups;
+      size_t numChunks;
+      size_t numSteals;
+      double overhead;      // Seconds spent claiming and stealing work
+    };
+    SchedulerStats getSchedulerStats() const;
+
   private:
     KernelInvocation(const Context *context, const Kernel *kernel,
                      unsigned int workDim,
@@ -56,11 +72,35 @@ namespace oclgrind
     Size3  m_numGroups;
 
     // Current execution state
-    std::vector<Size3>    m_workGroups;
+    // Work-groups are run in order of their linear index (or just the
+    // sampled groups in quick or sampling mode), skipping groups already
+    // started by switchWorkItem
+    size_t m_numWorkGroups;
+    std::vector<size_t> m_sampledGroups;
+    bool m_sampleUninstrumented;
+
+    // Work-groups that raised errors while running without plugins
+    bool m_replay;
+    bool m_recordFlaggedGroups;
+    bool m_replaying;
+    std::vector<size_t> m_flaggedGroups;
+    std::mutex m_flaggedGroupsMutex;
+    std::unordered_set<size_t> m_startedGroups;
     std::list<WorkGroup*> m_runningGroups;
+    size_t getWorkGroupIndex(size_t position) const;
 
     // Worker threads
+    // Each worker owns a range of work-group positions, which it claims in
+    // chunks sized by how long its work-groups take to run, and steals from
+    // other workers once its own range is exhausted
+    struct Worker;
+    std::vector<Worker*> m_workers;
+    bool claimChunk(Worker *worker);
+    bool nextWorkGroup(Worker *worker, size_t& position);
+    bool stealWork(Worker *worker);
+    void runWorkGroups();
     void runWorker(int id);
     unsigned m_numWorkers;
+    bool m_recycleWorkItems;
   };
 }
@@ -8,11 +8,19 @@
 
 #include "common.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstring>
 #include <mutex>
 
+#if !defined(_WIN32)
+#define HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "Context.h"
 #include "Memory.h"
 #include "WorkGroup.h"
@@ -22,11 +30,39 @@ using namespace oclgrind;
 using namespace std;
 
 // Multiple mutexes to mitigate risk of unnecessary synchronisation in atomics
+// Only used for global atomics that cannot be performed lock-free
 #define NUM_ATOMIC_MUTEXES 64 // Must be power of two
 mutex atomicMutex[NUM_ATOMIC_MUTEXES];
 #define ATOMIC_MUTEX(offset) \
   atomicMutex[(((offset)>>2) & (NUM_ATOMIC_MUTEXES-1))]
 
+#if defined(__GNUC__) || defined(__clang__)
+#define HAVE_ATOMIC_BUILTINS 1
+#endif
+
+// Minimum size of buffers that are allocated with mmap
+#define MMAP_THRESHOLD (128*1024)
+
+// Default minimum size of buffers that are backed by files
+#define DEFAULT_FILE_THRESHOLD (64*1048576)
+
+// Amount of a file-backed buffer to read ahead of sequential accesses
+#define PREFETCH_WINDOW ((size_t)4*1048576)
+
+// Recent sequential access streams through file-backed buffers
+#define NUM_PREFETCH_STREAMS 4
+struct PrefetchStream
+{
+  const Memory::Buffer *buffer;
+  size_t end;
+};
+static THREAD_LOCAL PrefetchStream prefetchStreams[NUM_PREFETCH_STREAMS];
+static THREAD_LOCAL unsigned nextPrefetchStream = 0;
+
+// Minimum size and alignment of private memory stack allocations
+#define STACK_CHUNK_SIZE 65536
+#define STACK_ALIGNMENT 16
+
 Memory::Memory(unsigned addrSpace, unsigned bufferBits, const Context *context)
 {
   m_context = context;
@@ -37,12 +73,37 @@ Memory::Memory(unsigned addrSpace, unsigned bufferBits, const Context *context)
   m_maxNumBuffers = ((size_t)1 << m_numBitsBuffer) - 1; // 0 reserved for NULL
   m_maxBufferSize = ((size_t)1 << m_numBitsAddress);
 
+  m_useStack = (addrSpace == AddrSpacePrivate);
+  m_stackChunk = 0;
+  m_stackOffset = 0;
+
+  m_fileThreshold = 0;
+  m_fileWarned = false;
+  const char *fileDir = getenv("OCLGRIND_GLOBAL_MEM_DIR");
+  if (addrSpace == AddrSpaceGlobal && fileDir)
+  {
+    m_fileDir = fileDir;
+    m_fileThreshold = getEnvInt("OCLGRIND_FILE_THRESHOLD",
+                                DEFAULT_FILE_THRESHOLD, false);
+  }
+
   clear();
 }
 
 Memory::~Memory()
 {
   clear();
+
+  for (auto chunk = m_stackChunks.begin(); chunk != m_stackChunks.end();
+       chunk++)
+  {
+    delete[] chunk->first;
+  }
+  for (auto buffer = m_freeBufferObjects.begin();
+       buffer != m_freeBufferObjects.end(); buffer++)
+  {
+    delete *buffer;
+  }
 }
 
 size_t Memory::allocateBuffer(size_t size, cl_mem_flags flags,
@@ -62,10 +123,15 @@ size_t Memory::allocateBuffer(size_t size, cl_mem_flags flags,
   }
 
   // Create buffer
-  Buffer *buffer = new Buffer;
+  Buffer *buffer = createBuffer();
   buffer->size   = size;
   buffer->flags  = flags;
-  buffer->data   = new unsigned char[size];
+  buffer->mapped = false;
+  buffer->fileBacked = false;
+  if (m_useStack)
+    buffer->data = pushStack(b, size);
+  else
+    buffer->data = allocateData(buffer);
 
   if (b >= m_memory.size())
   {
@@ -78,10 +144,10 @@ size_t Memory::allocateBuffer(size_t size, cl_mem_flags flags,
 
   m_totalAllocated += size;
 
-  // Initialize contents of buffer
+  // Initialize contents of buffer (mapped buffers are already zeroed)
   if (initData)
     memcpy(buffer->data, initData, size);
-  else
+  else if (!buffer->mapped)
     memset(buffer->data, 0, size);
 
   size_t address = ((size_t)b) << m_numBitsAddress;
@@ -96,67 +162,150 @@ template int64_t Memory::atomic(AtomicOp op, size_t address, int64_t value);
 template uint32_t Memory::atomic(AtomicOp op, size_t address, uint32_t value);
 template int32_t Memory::atomic(AtomicOp op, size_t address, int32_t value);
 
-template<typename T>
-T Memory::atomic(AtomicOp op, size_t address, T value)
+unsigned char* Memory::allocateData(Buffer *buffer)
 {
-  m_context->notifyMemoryAtomicLoad(this, op, address, sizeof(T));
-  m_context->notifyMemoryAtomicStore(this, op, address, sizeof(T));
-
-  // Bounds check
-  if (!isAddressValid(address, sizeof(T)))
+#ifdef HAVE_MMAP
+  if (m_fileThreshold && buffer->size >= m_fileThreshold)
   {
-    return 0;
+    unsigned char *data = mapFile(buffer);
+    if (data)
+      return data;
+
+    // Only warn once, as later allocations are likely to fail in the same way
+    if (!m_fileWarned)
+    {
+      Context::Message msg(WARNING, m_context);
+      msg << "Unable to back global memory with files in " << m_fileDir
+          << endl
+          << msg.INDENT << "Falling back to anonymous memory" << endl;
+      msg.send();
+      m_fileWarned = true;
+    }
   }
 
-  // Get buffer
-  size_t offset = extractOffset(address);
-  Buffer *buffer = m_memory[extractBuffer(address)];
-  T *ptr = (T*)(buffer->data + offset);
+  if (buffer->size >= MMAP_THRESHOLD)
+  {
+    void *data = mmap(NULL, buffer->size, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (data != MAP_FAILED)
+    {
+      buffer->mapped = true;
+      return (unsigned char*)data;
+    }
+  }
+#endif
 
-  if (m_addressSpace == AddrSpaceGlobal)
-    ATOMIC_MUTEX(offset).lock();
+  return new unsigned char[buffer->size];
+}
 
-  T old = *ptr;
+template<typename T>
+static T applyAtomicOp(AtomicOp op, T old, T value)
+{
   switch(op)
   {
   case AtomicAdd:
-    *ptr = old + value;
-    break;
+    return old + value;
   case AtomicAnd:
-    *ptr = old & value;
-    break;
+    return old & value;
   case AtomicCmpXchg:
     FATAL_ERROR("AtomicCmpXchg in generic atomic handler");
-    break;
   case AtomicDec:
-    *ptr = old - 1;
-    break;
+    return old - 1;
   case AtomicInc:
-    *ptr = old + 1;
-    break;
+    return old + 1;
   case AtomicMax:
-    *ptr = old > value ? old : value;
-    break;
+    return old > value ? old : value;
   case AtomicMin:
-    *ptr = old < value ? old : value;
-    break;
+    return old < value ? old : value;
   case AtomicOr:
-    *ptr = old | value;
-    break;
+    return old | value;
   case AtomicSub:
-    *ptr = old - value;
-    break;
+    return old - value;
   case AtomicXchg:
-    *ptr = value;
-    break;
+    return value;
   case AtomicXor:
-    *ptr = old ^ value;
-    break;
+    return old ^ value;
   }
+  return old;
+}
 
-  if (m_addressSpace == AddrSpaceGlobal)
-    ATOMIC_MUTEX(offset).unlock();
+// Returns true if an atomic on ptr can be performed without a mutex
+template<typename T>
+static bool isLockFree(const T *ptr)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+  return ((uintptr_t)ptr % sizeof(T)) == 0 &&
+         __atomic_always_lock_free(sizeof(T), 0);
+#else
+  return false;
+#endif
+}
 
+template<typename T>
+static T atomicLockFree(AtomicOp op, T *ptr, T value)
+{
+#ifdef HAVE_ATOMIC_BUILTINS
+  switch (op)
+  {
+  case AtomicAdd:
+    return __atomic_fetch_add(ptr, value, __ATOMIC_SEQ_CST);
+  case AtomicAnd:
+    return __atomic_fetch_and(ptr, value, __ATOMIC_SEQ_CST);
+  case AtomicOr:
+    return __atomic_fetch_or(ptr, value, __ATOMIC_SEQ_CST);
+  case AtomicSub:
+    return __atomic_fetch_sub(ptr, value, __ATOMIC_SEQ_CST);
+  case AtomicXchg:
+    return __atomic_exchange_n(ptr, value, __ATOMIC_SEQ_CST);
+  case AtomicXor:
+    return __atomic_fetch_xor(ptr, value, __ATOMIC_SEQ_CST);
+  default:
+  {
+    // Use a compare-exchange loop for operations without a builtin
+    T old = __atomic_load_n(ptr, __ATOMIC_SEQ_CST);
+    while (!__atomic_compare_exchange_n(ptr, &old,
+                                        applyAtomicOp(op, old, value), true,
+                                        __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST));
+    return old;
+  }
+  }
+#else
+  FATAL_ERROR("Lock-free atomics not supported");
+#endif
+}
+
+template<typename T>
+T Memory::atomic(AtomicOp op, size_t address, T value)
+{
+  m_context->notifyMemoryAtomicLoad(this, op, address, sizeof(T));
+  m_context->notifyMemoryAtomicStore(this, op, address, sizeof(T));
+
+  // Bounds check
+  if (!isAddressValid(address, sizeof(T)))
+  {
+    return 0;
+  }
+
+  // Get buffer
+  size_t offset = extractOffset(address);
+  Buffer *buffer = m_memory[extractBuffer(address)];
+  T *ptr = (T*)(buffer->data + offset);
+
+  // Work-items in other work-groups may access global memory concurrently
+  if (m_addressSpace != AddrSpaceGlobal)
+  {
+    T old = *ptr;
+    *ptr = applyAtomicOp(op, old, value);
+    return old;
+  }
+  if (isLockFree(ptr))
+  {
+    return atomicLockFree(op, ptr, value);
+  }
+
+  lock_guard<mutex> lock(ATOMIC_MUTEX(offset));
+  T old = *ptr;
+  *ptr = applyAtomicOp(op, old, value);
   return old;
 }
 
@@ -179,6 +328,21 @@ T Memory::atomicCmpxchg(size_t address, T cmp, T value)
   Buffer *buffer = m_memory[extractBuffer(address)];
   T *ptr = (T *)(buffer->data + offset);
 
+#ifdef HAVE_ATOMIC_BUILTINS
+  if (m_addressSpace == AddrSpaceGlobal && isLockFree(ptr))
+  {
+    // Perform cmpxchg directly on buffer memory
+    T old = cmp;
+    if (__atomic_compare_exchange_n(ptr, &old, value, false,
+                                    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST))
+    {
+      m_context->notifyMemoryAtomicStore(this, AtomicCmpXchg,
+                                         address, sizeof(T));
+    }
+    return old;
+  }
+#endif
+
   if (m_addressSpace == AddrSpaceGlobal)
     ATOMIC_MUTEX(offset).lock();
 
@@ -204,9 +368,9 @@ void Memory::clear()
   {
     if (*itr)
     {
-      if (!((*itr)->flags & CL_MEM_USE_HOST_PTR))
+      if (!((*itr)->flags & CL_MEM_USE_HOST_PTR) && !m_useStack)
       {
-        delete[] (*itr)->data;
+        releaseData(*itr);
       }
       delete *itr;
 
@@ -218,6 +382,21 @@ void Memory::clear()
   m_memory[0] = NULL;
   m_freeBuffers = queue<unsigned>();
   m_totalAllocated = 0;
+
+  m_stack.clear();
+  m_stackChunk = 0;
+  m_stackOffset = 0;
+}
+
+void Memory::clearPluginData(unsigned index)
+{
+  if (m_pluginData.get(index))
+    m_pluginData.set(index, NULL);
+  for (Buffer *buffer : m_memory)
+  {
+    if (buffer && buffer->pluginData.get(index))
+      buffer->pluginData.set(index, NULL);
+  }
 }
 
 size_t Memory::createHostBuffer(size_t size, void *ptr, cl_mem_flags flags)
@@ -236,10 +415,12 @@ size_t Memory::createHostBuffer(size_t size, void *ptr, cl_mem_flags flags)
   }
 
   // Create buffer
-  Buffer *buffer = new Buffer;
+  Buffer *buffer = createBuffer();
   buffer->size   = size;
   buffer->flags  = flags;
   buffer->data   = (unsigned char*)ptr;
+  buffer->mapped = false;
+  buffer->fileBacked = false;
 
   if (b >= m_memory.size())
   {
@@ -291,25 +472,109 @@ bool Memory::copy(size_t dst, size_t src, size_t size)
   return true;
 }
 
+void Memory::createSnapshot(Snapshot& snapshot,
+                            const set<size_t>& addresses) const
+{
+  // Copy each buffer containing one of the addresses
+  snapshot.clear();
+  for (size_t address : addresses)
+  {
+    unsigned b = extractBuffer(address);
+    if (b && b < m_memory.size() && m_memory[b] && !snapshot.count(b))
+    {
+      const Buffer *buffer = m_memory[b];
+      snapshot[b].assign(buffer->data, buffer->data + buffer->size);
+    }
+  }
+}
+
 void Memory::deallocateBuffer(size_t address)
 {
   unsigned buffer = extractBuffer(address);
   assert(buffer < m_memory.size() && m_memory[buffer]);
 
-  if (!(m_memory[buffer]->flags & CL_MEM_USE_HOST_PTR))
+  if (m_useStack)
+  {
+    popStack(buffer);
+  }
+  else if (!(m_memory[buffer]->flags & CL_MEM_USE_HOST_PTR))
   {
-    delete[] m_memory[buffer]->data;
+    releaseData(m_memory[buffer]);
   }
 
   m_totalAllocated -= m_memory[buffer]->size;
   m_freeBuffers.push(buffer);
 
-  delete m_memory[buffer];
+  if (m_useStack)
+    m_freeBufferObjects.push_back(m_memory[buffer]);
+  else
+    delete m_memory[buffer];
   m_memory[buffer] = NULL;
 
   m_context->notifyMemoryDeallocated(this, address);
 }
 
+Memory::Buffer* Memory::createBuffer()
+{
+  if (m_freeBufferObjects.empty())
+  {
+    return new Buffer;
+  }
+
+  Buffer *buffer = m_freeBufferObjects.back();
+  m_freeBufferObjects.pop_back();
+  buffer->pluginData = PluginData();
+  return buffer;
+}
+
+unsigned char* Memory::pushStack(unsigned buffer, size_t size)
+{
+  // Record stack position before allocation
+  StackEntry entry = {buffer, m_stackChunk, m_stackOffset};
+  m_stack.push_back(entry);
+
+  size_t offset = (m_stackOffset + STACK_ALIGNMENT-1) & ~(STACK_ALIGNMENT-1);
+  while (m_stackChunk < m_stackChunks.size() &&
+         offset + size > m_stackChunks[m_stackChunk].second)
+  {
+    // Move to next chunk
+    m_stackChunk++;
+    offset = 0;
+  }
+
+  if (m_stackChunk == m_stackChunks.size())
+  {
+    // Allocate new chunk large enough for this allocation
+    size_t chunkSize = max(size, (size_t)STACK_CHUNK_SIZE);
+    m_stackChunks.push_back(make_pair(new unsigned char[chunkSize],
+                                      chunkSize));
+  }
+
+  m_stackOffset = offset + size;
+  return m_stackChunks[m_stackChunk].first + offset;
+}
+
+void Memory::popStack(unsigned buffer)
+{
+  // Mark the most recent allocation of this buffer as released
+  for (auto entry = m_stack.rbegin(); entry != m_stack.rend(); entry++)
+  {
+    if (entry->buffer == buffer)
+    {
+      entry->buffer = 0;
+      break;
+    }
+  }
+
+  // Rewind stack past all released allocations
+  while (!m_stack.empty() && m_stack.back().buffer == 0)
+  {
+    m_stackChunk = m_stack.back().chunk;
+    m_stackOffset = m_stack.back().offset;
+    m_stack.pop_back();
+  }
+}
+
 void Memory::dump() const
 {
   for (unsigned b = 1; b < m_memory.size(); b++)
@@ -379,6 +644,11 @@ unsigned Memory::getNextBuffer()
   }
 }
 
+void* Memory::getPluginData(unsigned index) const
+{
+  return m_pluginData.get(index);
+}
+
 void* Memory::getPointer(size_t address) const
 {
   size_t buffer = extractBuffer(address);
@@ -392,6 +662,39 @@ void* Memory::getPointer(size_t address) const
   return m_memory[buffer]->data + extractOffset(address);
 }
 
+size_t Memory::getResidentSize() const
+{
+  size_t resident = 0;
+  for (unsigned b = 1; b < m_memory.size(); b++)
+  {
+    const Buffer *buffer = m_memory[b];
+    if (!buffer)
+      continue;
+
+#ifdef HAVE_MMAP
+    if (buffer->mapped)
+    {
+      // Count pages of the mapping that have been committed
+      size_t pageSize = sysconf(_SC_PAGESIZE);
+      size_t numPages = (buffer->size + pageSize - 1) / pageSize;
+      vector<unsigned char> pages(numPages);
+      if (mincore(buffer->data, buffer->size, pages.data()) == 0)
+      {
+        for (size_t p = 0; p < numPages; p++)
+        {
+          if (pages[p] & 1)
+            resident += pageSize;
+        }
+        continue;
+      }
+    }
+#endif
+
+    resident += buffer->size;
+  }
+  return resident;
+}
+
 size_t Memory::getTotalAllocated() const
 {
   return m_totalAllocated;
@@ -424,6 +727,8 @@ bool Memory::load(unsigned char *dest, size_t address, size_t size) const
   // Get buffer
   size_t offset = extractOffset(address);
   Buffer *src = m_memory[extractBuffer(address)];
+  if (src->fileBacked)
+    prefetch(src, offset, size);
 
   // Load data
   memcpy(dest, src->data + offset, size);
@@ -431,6 +736,35 @@ bool Memory::load(unsigned char *dest, size_t address, size_t size) const
   return true;
 }
 
+unsigned char* Memory::mapFile(Buffer *buffer)
+{
+#ifdef HAVE_MMAP
+  // Create a sparse file that is removed as soon as it is unmapped
+  string path = m_fileDir + "/oclgrind-XXXXXX";
+  int fd = mkstemp(&path[0]);
+  if (fd < 0)
+    return NULL;
+  unlink(path.c_str());
+
+  void *data = MAP_FAILED;
+  if (ftruncate(fd, buffer->size) == 0)
+  {
+    data = mmap(NULL, buffer->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                fd, 0);
+  }
+  close(fd);
+
+  if (data == MAP_FAILED)
+    return NULL;
+
+  buffer->mapped = true;
+  buffer->fileBacked = true;
+  return (unsigned char*)data;
+#else
+  return NULL;
+#endif
+}
+
 void* Memory::mapBuffer(size_t address, size_t offset, size_t size)
 {
   size_t buffer = extractBuffer(address);
@@ -444,6 +778,77 @@ void* Memory::mapBuffer(size_t address, size_t offset, size_t size)
   return m_memory[buffer]->data + offset + extractOffset(address);
 }
 
+void Memory::prefetch(const Buffer *buffer, size_t offset, size_t size) const
+{
+#ifdef HAVE_MMAP
+  // Find the stream that this access continues, if any
+  PrefetchStream *stream = NULL;
+  for (unsigned i = 0; i < NUM_PREFETCH_STREAMS; i++)
+  {
+    if (prefetchStreams[i].buffer == buffer)
+    {
+      stream = prefetchStreams + i;
+      break;
+    }
+  }
+
+  size_t end = offset + size;
+  if (!stream || end < stream->end - min(stream->end, 2*PREFETCH_WINDOW) ||
+      end > stream->end + PREFETCH_WINDOW)
+  {
+    // Random access, so start tracking a new stream from here
+    if (!stream)
+    {
+      stream = prefetchStreams + nextPrefetchStream;
+      nextPrefetchStream = (nextPrefetchStream + 1) % NUM_PREFETCH_STREAMS;
+      stream->buffer = buffer;
+    }
+    stream->end = end;
+    return;
+  }
+
+  // Read ahead once the stream gets within a window of the last prefetch
+  if (end + PREFETCH_WINDOW > stream->end && stream->end < buffer->size)
+  {
+    size_t pageSize = sysconf(_SC_PAGESIZE);
+    size_t begin = max(stream->end, end) & ~(pageSize - 1);
+    size_t length = min(PREFETCH_WINDOW, buffer->size - begin);
+    madvise(buffer->data + begin, length, MADV_WILLNEED);
+    stream->end = begin + length;
+  }
+#endif
+}
+
+void Memory::releaseData(Buffer *buffer)
+{
+#ifdef HAVE_MMAP
+  if (buffer->mapped)
+  {
+    munmap(buffer->data, buffer->size);
+    buffer->mapped = false;
+    buffer->fileBacked = false;
+    return;
+  }
+#endif
+
+  delete[] buffer->data;
+}
+
+void Memory::resizePluginData(unsigned numSlots)
+{
+  m_pluginData.resize(numSlots);
+  for (Buffer *buffer : m_memory)
+  {
+    if (buffer)
+      buffer->pluginData.resize(numSlots);
+  }
+}
+
+void Memory::setPluginData(unsigned index, void *data) const
+{
+  m_pluginData.set(index, data);
+}
+
 bool Memory::store(const unsigned char *source, size_t address, size_t size)
 {
   m_context->notifyMemoryStore(this, address, size, source);
@@ -457,9 +862,28 @@ bool Memory::store(const unsigned char *source, size_t address, size_t size)
   // Get buffer
   size_t offset = extractOffset(address);
   Buffer *dst = m_memory[extractBuffer(address)];
+  if (dst->fileBacked)
+    prefetch(dst, offset, size);
 
   // Store data
   memcpy(dst->data + offset, source, size);
 
   return true;
 }
+
+void Memory::swapSnapshot(Snapshot& snapshot)
+{
+  // Exchange buffer contents with the snapshot in place, so that no extra
+  // copy is needed to keep the current contents
+  // Plugins are not notified, as this does not change which bytes are valid
+  for (auto& entry : snapshot)
+  {
+    Buffer *buffer = entry.first < m_memory.size() ? m_memory[entry.first]
+                                                   : NULL;
+    if (buffer)
+    {
+      size_t size = min(buffer->size, entry.second.size());
+      swap_ranges(buffer->data, buffer->data + size, entry.second.begin());
+    }
+  }
+}
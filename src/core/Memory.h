@@ -20,8 +20,14 @@ namespace oclgrind
       size_t size;
       cl_mem_flags flags;
       unsigned char *data;
+      bool mapped;          // Data is backed by an mmap'd region
+      bool fileBacked;      // Mapped region is backed by a file on disk
+      mutable PluginData pluginData;
     };
 
+    // Copy of the contents of selected buffers, indexed by buffer
+    typedef std::map< unsigned, std::vector<unsigned char> > Snapshot;
+
   public:
     Memory(unsigned addrSpace, unsigned bufferBits, const Context *context);
     virtual ~Memory();
@@ -31,18 +37,26 @@ namespace oclgrind
     template<typename T> T atomic(AtomicOp op, size_t address, T value = 0);
     template<typename T> T atomicCmpxchg(size_t address, T cmp, T value);
     void clear();
+    void clearPluginData(unsigned index);
     size_t createHostBuffer(size_t size, void *ptr, cl_mem_flags flags=0);
+    void createSnapshot(Snapshot& snapshot,
+                        const std::set<size_t>& addresses) const;
     bool copy(size_t dest, size_t src, size_t size);
     void deallocateBuffer(size_t address);
     void dump() const;
     unsigned int getAddressSpace() const;
     const Buffer* getBuffer(size_t address) const;
+    void* getPluginData(unsigned index) const;
     void* getPointer(size_t address) const;
+    size_t getResidentSize() const;
     size_t getTotalAllocated() const;
     bool isAddressValid(size_t address, size_t size=1) const;
     bool load(unsigned char *dst, size_t address, size_t size=1) const;
     void* mapBuffer(size_t address, size_t offset, size_t size);
+    void resizePluginData(unsigned numSlots);
+    void setPluginData(unsigned index, void *data) const;
     bool store(const unsigned char *source, size_t address, size_t size=1);
+    void swapSnapshot(Snapshot& snapshot);
 
     size_t extractBuffer(size_t address) const;
     size_t extractOffset(size_t address) const;
@@ -51,6 +65,7 @@ namespace oclgrind
 
   private:
     const Context *m_context;
+    mutable PluginData m_pluginData;
     std::queue<unsigned> m_freeBuffers;
     std::vector<Buffer*> m_memory;
     unsigned int m_addressSpace;
@@ -62,5 +77,37 @@ namespace oclgrind
     size_t m_maxBufferSize;
 
     unsigned getNextBuffer();
+
+    // Large buffers are mapped directly from the OS, so that they are
+    // zero-filled for free and only committed when pages are touched
+    unsigned char* allocateData(Buffer *buffer);
+    void releaseData(Buffer *buffer);
+
+    // Buffers above a size threshold can instead be backed by sparse files,
+    // allowing global memory to exceed the RAM of the host
+    std::string m_fileDir;
+    size_t m_fileThreshold;
+    bool m_fileWarned;
+    unsigned char* mapFile(Buffer *buffer);
+    void prefetch(const Buffer *buffer, size_t offset, size_t size) const;
+
+    // Private memory is allocated and released in stack order, so buffer
+    // data is carved from a bump-pointer arena and Buffer objects are reused
+    struct StackEntry
+    {
+      unsigned buffer;
+      unsigned chunk;
+      size_t offset;
+    };
+    bool m_useStack;
+    std::vector<std::pair<unsigned char*,size_t>> m_stackChunks;
+    std::vector<StackEntry> m_stack;
+    unsigned m_stackChunk;
+    size_t m_stackOffset;
+    std::vector<Buffer*> m_freeBufferObjects;
+
+    Buffer* createBuffer();
+    unsigned char* pushStack(unsigned buffer, size_t size);
+    void popStack(unsigned buffer);
   };
 }
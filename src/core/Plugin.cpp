@@ -6,6 +6,7 @@
 // license terms please see the LICENSE file distributed with this
 // source code.
 
+#include "Context.h"
 #include "Plugin.h"
 
 using namespace oclgrind;
@@ -13,13 +14,35 @@ using namespace oclgrind;
 Plugin::Plugin(const Context *context)
   : m_context(context)
 {
+  m_index = m_context->allocatePluginIndex();
 }
 
 Plugin::~Plugin()
 {
+  m_context->releasePluginIndex(m_index);
+}
+
+unsigned Plugin::getIndex() const
+{
+  return m_index;
 }
 
 bool Plugin::isThreadSafe() const
 {
   return true;
 }
+
+bool Plugin::needsEvent(Event event) const
+{
+  return true;
+}
+
+bool Plugin::needsInstruction(unsigned opcode) const
+{
+  return true;
+}
+
+bool Plugin::supportsAsyncEvents() const
+{
+  return false;
+}
@@ -21,6 +21,46 @@ namespace oclgrind
 
   class Plugin
   {
+  public:
+    // Events that plugins can subscribe to, one for each handler below
+    enum Event
+    {
+      EventHostMemoryLoad,
+      EventHostMemoryStore,
+      EventInstructionExecuted,
+      EventKernelBegin,
+      EventKernelEnd,
+      EventLog,
+      EventMemoryAllocated,
+      EventMemoryAtomicLoad,
+      EventMemoryAtomicStore,
+      EventMemoryDeallocated,
+      EventMemoryLoad,
+      EventMemoryMap,
+      EventMemoryStore,
+      EventMemoryUnmap,
+      EventWorkGroupBarrier,
+      EventWorkGroupBegin,
+      EventWorkGroupComplete,
+      EventWorkItemBegin,
+      EventWorkItemComplete,
+      NumEvents
+    };
+
+    // Record of an instruction or memory event raised by a work-item (or a
+    // work-group, for which workItem is -1) for asynchronous processing
+    struct AsyncEvent
+    {
+      Event event;
+      const llvm::Instruction *instruction;
+      const Memory *memory;
+      size_t address;
+      size_t size;
+      AtomicOp op;
+      size_t workGroup;     // Linear index of the work-group
+      size_t workItem;      // Global linear index of the work-item
+    };
+
   public:
     Plugin(const Context *context);
     virtual ~Plugin();
@@ -68,7 +108,28 @@ namespace oclgrind
 
     virtual bool isThreadSafe() const;
 
+    // New virtuals go below, so that existing vtable slots keep their place
+    // for plugins built against older headers
+
+    // Subscriptions are queried once, when the plugin is registered
+    // Plugins only receive instructionExecuted for opcodes they need
+    virtual bool needsEvent(Event event) const;
+    virtual bool needsInstruction(unsigned opcode) const;
+
+    // In asynchronous mode, plugins that support it receive their
+    // instruction and memory events in batches on analysis threads, which
+    // may call this concurrently while the kernel is still running
+    // All events are delivered before kernelEnd
+    virtual void asyncEvents(const AsyncEvent *events, size_t num){}
+    virtual bool supportsAsyncEvents() const;
+
+    // Index of this plugin's data slot in each entity
+    unsigned getIndex() const;
+
   protected:
     const Context *m_context;
+
+  private:
+    unsigned m_index;
   };
 }
@@ -16,6 +16,7 @@
 #include "Kernel.h"
 #include "KernelInvocation.h"
 #include "Memory.h"
+#include "Program.h"
 #include "WorkGroup.h"
 #include "WorkItem.h"
 
@@ -31,47 +32,23 @@ WorkGroup::WorkGroup(const KernelInvocation *kernelInvocation,
                      Size3 wgid, Size3 size)
  : m_context(kernelInvocation->getContext())
 {
-  m_groupID   = wgid;
-  m_groupSize = size;
-
-  m_groupIndex = (m_groupID.x +
-                 (m_groupID.y +
-                  m_groupID.z*(kernelInvocation->getNumGroups().y) *
-                  kernelInvocation->getNumGroups().x));
+  m_kernelInvocation = kernelInvocation;
 
   // Allocate local memory
   m_localMemory = new Memory(AddrSpaceLocal, sizeof(size_t)==8 ? 16 : 8,
                              m_context);
+  allocateLocalMemory();
+
+  // Create storage for cached constant expression results
   const Kernel *kernel = kernelInvocation->getKernel();
-  for (auto value = kernel->values_begin();
-            value != kernel->values_end();
-            value++)
-  {
-    const llvm::Type *type = value->first->getType();
-    if (type->isPointerTy() && type->getPointerAddressSpace() == AddrSpaceLocal)
-    {
-      size_t ptr = m_localMemory->allocateBuffer(value->second.size);
-      m_localAddresses[value->first] = ptr;
-    }
-  }
+  const InterpreterCache *cache =
+    kernel->getProgram()->getInterpreterCache(kernel->getFunction());
+  m_constExprValues.resize(cache->getNumConstantExprs());
 
-  // Initialise work-items
-  for (size_t k = 0; k < m_groupSize.z; k++)
-  {
-    for (size_t j = 0; j < m_groupSize.y; j++)
-    {
-      for (size_t i = 0; i < m_groupSize.x; i++)
-      {
-        WorkItem *workItem = new WorkItem(kernelInvocation, this,
-                                          Size3(i, j, k));
-        m_workItems.push_back(workItem);
-        m_running.insert(workItem);
-      }
-    }
-  }
+  // Kernels that never synchronize the group can reuse a single work-item
+  m_recycleWorkItems = kernelInvocation->canRecycleWorkItems();
 
-  m_nextEvent = 1;
-  m_barrier = NULL;
+  setGroup(wgid, size);
 }
 
 WorkGroup::~WorkGroup()
@@ -81,10 +58,30 @@ WorkGroup::~WorkGroup()
   {
     delete m_workItems[i];
   }
+  for (unsigned i = 0; i < m_freeWorkItems.size(); i++)
+  {
+    delete m_freeWorkItems[i];
+  }
 
   delete m_localMemory;
 }
 
+void WorkGroup::allocateLocalMemory()
+{
+  const Kernel *kernel = m_kernelInvocation->getKernel();
+  for (auto value = kernel->values_begin();
+            value != kernel->values_end();
+            value++)
+  {
+    const llvm::Type *type = value->first->getType();
+    if (type->isPointerTy() && type->getPointerAddressSpace() == AddrSpaceLocal)
+    {
+      size_t ptr = m_localMemory->allocateBuffer(value->second.size);
+      m_localAddresses[value->first] = ptr;
+    }
+  }
+}
+
 size_t WorkGroup::async_copy(
   const WorkItem *workItem,
   const llvm::Instruction *instruction,
@@ -112,10 +109,11 @@ size_t WorkGroup::async_copy(
   };
 
   // Check if copy has already been registered by another work-item
-  list< pair<AsyncCopy,set<const WorkItem*> > >::iterator itr;
+  size_t index = getLocalIndex(workItem);
+  list< pair<AsyncCopy,WorkItemMask> >::iterator itr;
   for (itr = m_asyncCopies.begin(); itr != m_asyncCopies.end(); itr++)
   {
-    if (itr->second.count(workItem))
+    if (itr->second.test(index))
     {
       continue;
     }
@@ -157,7 +155,7 @@ size_t WorkGroup::async_copy(
       msg.send();
     }
 
-    itr->second.insert(workItem);
+    itr->second.set(index);
     return itr->first.event;
   }
 
@@ -168,8 +166,8 @@ size_t WorkGroup::async_copy(
   }
 
   // Register new copy and event
-  m_asyncCopies.push_back(make_pair(copy, set<const WorkItem*>()));
-  m_asyncCopies.back().second.insert(workItem);
+  m_asyncCopies.push_back(make_pair(copy, WorkItemMask(m_numWorkItems)));
+  m_asyncCopies.back().second.set(index);
   if (!m_events.count(event))
   {
     m_events[copy.event] = list<AsyncCopy>();
@@ -184,29 +182,27 @@ void WorkGroup::clearBarrier()
   assert(m_barrier);
 
   // Check for divergence
-  if (m_barrier->workItems.size() != m_workItems.size())
+  if (m_barrier->workItems.count() != m_numWorkItems)
   {
     Context::Message msg(ERROR, m_context);
     msg << "Work-group divergence detected (barrier)" << endl
         << msg.INDENT
         << "Kernel:     " << msg.CURRENT_KERNEL << endl
         << "Work-group: " << msg.CURRENT_WORK_GROUP << endl
-        << "Only " << dec << m_barrier->workItems.size() << " out of "
-        << m_workItems.size() << " work-items executed barrier" << endl
+        << "Only " << dec << m_barrier->workItems.count() << " out of "
+        << m_numWorkItems << " work-items executed barrier" << endl
         << m_barrier->instruction << endl;
     msg.send();
   }
 
   // Move work-items to running state
-  set<WorkItem*>::iterator itr;
-  for (itr = m_barrier->workItems.begin();
-       itr != m_barrier->workItems.end();
-       itr++)
+  for (size_t i = m_barrier->workItems.next(0);
+       i < m_numWorkItems;
+       i = m_barrier->workItems.next(i+1))
   {
-    (*itr)->clearBarrier();
-    m_running.insert(*itr);
+    getWorkItemAt(i)->clearBarrier();
+    m_running.set(i);
   }
-  m_barrier->workItems.clear();
 
   // Deal with events
   while (!m_barrier->events.empty())
@@ -245,21 +241,21 @@ void WorkGroup::clearBarrier()
     m_events.erase(event);
 
     // Remove copies from list for this event
-    list< pair<AsyncCopy,set<const WorkItem*> > >::iterator cItr;
+    list< pair<AsyncCopy,WorkItemMask> >::iterator cItr;
     for (cItr = m_asyncCopies.begin(); cItr != m_asyncCopies.end();)
     {
       if (cItr->first.event == event)
       {
         // Check that all work-items registered the copy
-        if (cItr->second.size() != m_workItems.size())
+        if (cItr->second.count() != m_numWorkItems)
         {
           Context::Message msg(ERROR, m_context);
           msg << "Work-group divergence detected (async copy)" << endl
               << msg.INDENT
               << "Kernel:     " << msg.CURRENT_KERNEL << endl
               << "Work-group: " << msg.CURRENT_WORK_GROUP << endl
-              << "Only " << dec << cItr->second.size() << " out of "
-              << m_workItems.size() << " work-items executed copy" << endl
+              << "Only " << dec << cItr->second.count() << " out of "
+              << m_numWorkItems << " work-items executed copy" << endl
               << cItr->first.instruction << endl;
           msg.send();
         }
@@ -277,15 +273,53 @@ void WorkGroup::clearBarrier()
 
   m_context->notifyWorkGroupBarrier(this, m_barrier->fence);
 
-  delete m_barrier;
   m_barrier = NULL;
 }
 
+WorkItem* WorkGroup::createWorkItem(size_t index)
+{
+  Size3 lid(index % m_groupSize.x,
+            (index / m_groupSize.x) % m_groupSize.y,
+            index / (m_groupSize.x * m_groupSize.y));
+
+  WorkItem *workItem;
+  if (m_recycleWorkItems)
+  {
+    // Reset the existing work-item to the next local ID
+    if (m_workItems[0])
+      m_workItems[0]->reset(lid);
+    else
+      m_workItems[0] = new WorkItem(m_kernelInvocation, this, lid);
+    workItem = m_workItems[0];
+  }
+  else if (!m_freeWorkItems.empty())
+  {
+    // Reuse a work-item left over from a previous work-group
+    workItem = m_freeWorkItems.back();
+    m_freeWorkItems.pop_back();
+    workItem->reset(lid);
+    m_workItems[index] = workItem;
+  }
+  else
+  {
+    workItem = new WorkItem(m_kernelInvocation, this, lid);
+    m_workItems[index] = workItem;
+  }
+
+  m_running.set(index);
+  return workItem;
+}
+
 const llvm::Instruction* WorkGroup::getCurrentBarrier() const
 {
   return m_barrier ? m_barrier->instruction : NULL;
 }
 
+TypedValue WorkGroup::getConstantExprValue(unsigned index) const
+{
+  return m_constExprValues[index];
+}
+
 Size3 WorkGroup::getGroupID() const
 {
   return m_groupID;
@@ -301,6 +335,12 @@ Size3 WorkGroup::getGroupSize() const
   return m_groupSize;
 }
 
+size_t WorkGroup::getLocalIndex(const WorkItem *workItem) const
+{
+  Size3 lid = workItem->getLocalID();
+  return lid.x + (lid.y + lid.z*m_groupSize.y)*m_groupSize.x;
+}
+
 Memory* WorkGroup::getLocalMemory() const
 {
   return m_localMemory;
@@ -311,19 +351,46 @@ size_t WorkGroup::getLocalMemoryAddress(const llvm::Value *value) const
   return m_localAddresses.at(value);
 }
 
-WorkItem* WorkGroup::getNextWorkItem() const
+WorkItem* WorkGroup::getNextWorkItem()
 {
-  if (m_running.empty())
+  if (!m_running.empty())
   {
-    return NULL;
+    return getWorkItemAt(m_running.next(0));
   }
-  return *m_running.begin();
+
+  // Start the next work-item that has not been created yet
+  for (; m_nextWorkItem < m_numWorkItems; m_nextWorkItem++)
+  {
+    if (m_recycleWorkItems || !m_workItems[m_nextWorkItem])
+    {
+      return createWorkItem(m_nextWorkItem++);
+    }
+  }
+
+  return NULL;
 }
 
-WorkItem* WorkGroup::getWorkItem(Size3 localID) const
+void* WorkGroup::getPluginData(unsigned index) const
 {
-  return m_workItems[localID.x +
-                    (localID.y + localID.z*m_groupSize.y)*m_groupSize.x];
+  return m_pluginData.get(index);
+}
+
+WorkItem* WorkGroup::getWorkItem(Size3 localID)
+{
+  assert(!m_recycleWorkItems);
+
+  size_t index = localID.x +
+                (localID.y + localID.z*m_groupSize.y)*m_groupSize.x;
+  if (!m_workItems[index])
+  {
+    createWorkItem(index);
+  }
+  return m_workItems[index];
+}
+
+WorkItem* WorkGroup::getWorkItemAt(size_t index) const
+{
+  return m_workItems[m_recycleWorkItems ? 0 : index];
 }
 
 bool WorkGroup::hasBarrier() const
@@ -338,8 +405,9 @@ void WorkGroup::notifyBarrier(WorkItem *workItem,
   if (!m_barrier)
   {
     // Create new barrier
-    m_barrier = new Barrier;
+    m_barrier = &m_barrierState;
     m_barrier->instruction = instruction;
+    m_barrier->workItems.reset(m_numWorkItems);
     m_barrier->fence = fence;
 
     m_barrier->events = events;
@@ -420,33 +488,154 @@ void WorkGroup::notifyBarrier(WorkItem *workItem,
     }
   }
 
-  m_running.erase(workItem);
-  m_barrier->workItems.insert(workItem);
+  size_t index = getLocalIndex(workItem);
+  m_running.clear(index);
+  m_barrier->workItems.set(index);
 }
 
 void WorkGroup::notifyFinished(WorkItem *workItem)
 {
-  m_running.erase(workItem);
+  m_running.clear(getLocalIndex(workItem));
 
   // Check if work-group finished without waiting for all events
-  if (m_running.empty() && !m_barrier && !m_events.empty())
+  if (m_running.empty() && m_nextWorkItem >= m_numWorkItems &&
+      !m_barrier && !m_events.empty())
   {
     m_context->logError("Work-item finished without waiting for events");
   }
 }
 
-bool WorkGroup::WorkItemCmp::operator()(const WorkItem *lhs,
-                                        const WorkItem *rhs) const
+void WorkGroup::release()
+{
+  m_localMemory->clear();
+  m_localAddresses.clear();
+}
+
+void WorkGroup::reset(Size3 wgid, Size3 size)
 {
-  Size3 lgid = lhs->getGlobalID();
-  Size3 rgid = rhs->getGlobalID();
-  if (lgid.z != rgid.z)
+  assert(m_running.empty() && !m_barrier);
+
+  // Keep work-items for reuse by the next group
+  for (unsigned i = 0; i < m_workItems.size(); i++)
   {
-    return lgid.z < rgid.z;
+    if (m_workItems[i] && !m_recycleWorkItems)
+    {
+      m_freeWorkItems.push_back(m_workItems[i]);
+      m_workItems[i] = NULL;
+    }
   }
-  if (lgid.y != rgid.y)
+
+  // Local memory was released when the previous group completed
+  allocateLocalMemory();
+
+  m_pluginData.clear();
+  m_constExprValues.assign(m_constExprValues.size(), TypedValue());
+  m_pool.reset();
+
+  m_asyncCopies.clear();
+  m_events.clear();
+
+  setGroup(wgid, size);
+}
+
+void WorkGroup::setConstantExprValue(unsigned index, const TypedValue& value)
+{
+  m_constExprValues[index] = m_pool.clone(value);
+}
+
+void WorkGroup::setPluginData(unsigned index, void *data) const
+{
+  m_pluginData.set(index, data);
+}
+
+void WorkGroup::setGroup(Size3 wgid, Size3 size)
+{
+  m_groupID   = wgid;
+  m_groupSize = size;
+
+  m_groupIndex = (m_groupID.x +
+                 (m_groupID.y +
+                  m_groupID.z*(m_kernelInvocation->getNumGroups().y) *
+                  m_kernelInvocation->getNumGroups().x));
+
+  // Work-items are created on demand, as many kernels finish a work-item
+  // long before the whole group would have been constructed
+  m_numWorkItems = m_groupSize.x * m_groupSize.y * m_groupSize.z;
+  m_nextWorkItem = 0;
+  m_workItems.resize(m_recycleWorkItems ? 1 : m_numWorkItems, NULL);
+  m_running.reset(m_numWorkItems);
+
+  m_nextEvent = 1;
+  m_barrier = NULL;
+}
+
+WorkGroup::WorkItemMask::WorkItemMask(size_t size)
+  : m_bits((size+63)/64, 0), m_size(size), m_count(0)
+{
+}
+
+void WorkGroup::WorkItemMask::clear(size_t index)
+{
+  uint64_t bit = 1ULL << (index%64);
+  if (m_bits[index/64] & bit)
   {
-    return lgid.y < rgid.y;
+    m_bits[index/64] &= ~bit;
+    m_count--;
   }
-  return lgid.x < rgid.x;
+}
+
+size_t WorkGroup::WorkItemMask::count() const
+{
+  return m_count;
+}
+
+bool WorkGroup::WorkItemMask::empty() const
+{
+  return m_count == 0;
+}
+
+size_t WorkGroup::WorkItemMask::next(size_t index) const
+{
+  // Find the first set bit at or after index, or return the mask size
+  if (!m_count)
+    return m_size;
+  for (size_t w = index/64; w < m_bits.size(); w++)
+  {
+    uint64_t bits = m_bits[w];
+    if (w == index/64)
+      bits &= ~0ULL << (index%64);
+    if (!bits)
+      continue;
+
+    size_t i = w*64;
+    while (!(bits & 1))
+    {
+      bits >>= 1;
+      i++;
+    }
+    return i;
+  }
+  return m_size;
+}
+
+void WorkGroup::WorkItemMask::reset(size_t size)
+{
+  m_bits.assign((size+63)/64, 0);
+  m_size = size;
+  m_count = 0;
+}
+
+void WorkGroup::WorkItemMask::set(size_t index)
+{
+  uint64_t bit = 1ULL << (index%64);
+  if (!(m_bits[index/64] & bit))
+  {
+    m_bits[index/64] |= bit;
+    m_count++;
+  }
+}
+
+bool WorkGroup::WorkItemMask::test(size_t index) const
+{
+  return m_bits[index/64] & (1ULL << (index%64));
 }
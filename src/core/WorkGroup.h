@@ -25,12 +25,26 @@ namespace oclgrind
     enum AsyncCopyType{GLOBAL_TO_LOCAL, LOCAL_TO_GLOBAL};
 
   private:
-    // Comparator for ordering work-items
-    struct WorkItemCmp
+    // Set of work-items in the group, stored as a bitmask indexed by local
+    // ID so that work-items can be added and removed in constant time
+    class WorkItemMask
     {
-      bool operator()(const WorkItem *lhs, const WorkItem *rhs) const;
+    public:
+      WorkItemMask(size_t size = 0);
+      void clear(size_t index);
+      size_t count() const;
+      bool empty() const;
+      size_t next(size_t index) const;
+      void reset(size_t size);
+      void set(size_t index);
+      bool test(size_t index) const;
+
+    private:
+      std::vector<uint64_t> m_bits;
+      size_t m_size;
+      size_t m_count;
     };
-    std::set<WorkItem*, WorkItemCmp> m_running;
+    WorkItemMask m_running;
 
     struct AsyncCopy
     {
@@ -49,7 +63,7 @@ namespace oclgrind
     struct Barrier
     {
       const llvm::Instruction *instruction;
-      std::set<WorkItem*, WorkItemCmp> workItems;
+      WorkItemMask workItems;
 
       uint64_t fence;
       std::list<size_t> events;
@@ -76,30 +90,53 @@ namespace oclgrind
     Size3 getGroupID() const;
     size_t getGroupIndex() const;
     Size3 getGroupSize() const;
+    TypedValue getConstantExprValue(unsigned index) const;
     Memory* getLocalMemory() const;
     size_t getLocalMemoryAddress(const llvm::Value *value) const;
-    WorkItem *getNextWorkItem() const;
-    WorkItem *getWorkItem(Size3 localID) const;
+    WorkItem *getNextWorkItem();
+    void* getPluginData(unsigned index) const;
+    WorkItem *getWorkItem(Size3 localID);
     bool hasBarrier() const;
     void notifyBarrier(WorkItem *workItem, const llvm::Instruction *instruction,
                        uint64_t fence,
                        std::list<size_t> events=std::list<size_t>());
     void notifyFinished(WorkItem *workItem);
+    void release();
+    void reset(Size3 wgid, Size3 size);
+    void setConstantExprValue(unsigned index, const TypedValue& value);
+    void setPluginData(unsigned index, void *data) const;
 
   private:
     size_t m_groupIndex;
     Size3 m_groupID;
     Size3 m_groupSize;
     const Context *m_context;
+    const KernelInvocation *m_kernelInvocation;
+    mutable PluginData m_pluginData;
 
     Memory *m_localMemory;
     std::map<const llvm::Value*,size_t> m_localAddresses;
+    void allocateLocalMemory();
 
+    // Work-items indexed by local ID, created on demand
     std::vector<WorkItem*> m_workItems;
+    std::vector<WorkItem*> m_freeWorkItems;
+    size_t m_numWorkItems;
+    size_t m_nextWorkItem;
+    bool m_recycleWorkItems;
+    WorkItem* createWorkItem(size_t index);
+    size_t getLocalIndex(const WorkItem *workItem) const;
+    WorkItem* getWorkItemAt(size_t index) const;
+    void setGroup(Size3 wgid, Size3 size);
+
+    // Cached results of constant expressions that are uniform in the group
+    std::vector<TypedValue> m_constExprValues;
+    MemoryPool m_pool;
 
     Barrier *m_barrier;
+    Barrier m_barrierState;
     size_t m_nextEvent;
-    std::list< std::pair<AsyncCopy,std::set<const WorkItem*> > > m_asyncCopies;
+    std::list< std::pair<AsyncCopy,WorkItemMask> > m_asyncCopies;
     std::map < size_t, std::list<AsyncCopy> > m_events;
   };
 }
@@ -9,8 +9,10 @@
 #include "config.h"
 #include "common.h"
 
+#include <functional>
 #include <math.h>
 
+#include "llvm/Analysis/ConstantFolding.h"
 #include "llvm/IR/DebugInfo.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/InstrTypes.h"
@@ -21,6 +23,7 @@
 #include "llvm/IR/InstIterator.h"
 
 #include "Context.h"
+#include "half.h"
 #include "Kernel.h"
 #include "KernelInvocation.h"
 #include "Memory.h"
@@ -34,92 +37,157 @@ using namespace std;
 struct WorkItem::Position
 {
   bool hasBegun;
-  const llvm::BasicBlock *             prevBlock;
-  const llvm::BasicBlock *             currBlock;
-  const llvm::BasicBlock *             nextBlock;
-  llvm::BasicBlock::const_iterator     currInst;
-  std::stack<const llvm::Instruction*> callStack;
-  std::stack< std::list<size_t> >      allocations;
+  const llvm::BasicBlock *                         prevBlock;
+  const llvm::BasicBlock *                         currBlock;
+  const InterpreterCache::Instruction *            currInst;
+  const InterpreterCache::Instruction *            nextInst;
+  std::stack<const llvm::Instruction*>             callStack;
+  std::stack<const InterpreterCache::Instruction*> returnStack;
+  std::stack< std::list<size_t> >                  allocations;
 };
 
+// Returns true if the value is a constant that is resolved ahead of time
+static bool isCachedConstant(unsigned valID)
+{
+  return (valID == llvm::Value::UndefValueVal            ||
+          valID == llvm::Value::ConstantAggregateZeroVal ||
+          valID == llvm::Value::ConstantDataArrayVal     ||
+          valID == llvm::Value::ConstantDataVectorVal    ||
+          valID == llvm::Value::ConstantIntVal           ||
+          valID == llvm::Value::ConstantFPVal            ||
+          valID == llvm::Value::ConstantArrayVal         ||
+          valID == llvm::Value::ConstantStructVal        ||
+          valID == llvm::Value::ConstantVectorVal        ||
+          valID == llvm::Value::ConstantPointerNullVal);
+}
+
+// Extract the (first) argument type from an overload string
+static char getOverloadArgType(const string& overload)
+{
+  char type = overload[0];
+  if (type == 'D')
+  {
+    char *typestr;
+    strtol(overload.c_str() + 2, &typestr, 10);
+    type = typestr[1];
+  }
+  return type;
+}
+
 WorkItem::WorkItem(const KernelInvocation *kernelInvocation,
                    WorkGroup *workGroup, Size3 lid)
   : m_context(kernelInvocation->getContext()),
     m_kernelInvocation(kernelInvocation),
     m_workGroup(workGroup)
+{
+  const Kernel *kernel = kernelInvocation->getKernel();
+
+  // Load interpreter cache
+  m_cache = kernel->getProgram()->getInterpreterCache(kernel->getFunction());
+
+  // Set initial number of values to store based on cache
+  m_values.resize(m_cache->getNumValues());
+  m_constExprValues.resize(m_cache->getNumConstantExprs());
+
+  // Point values at their fixed storage slots
+  m_valueStorage = new unsigned char[m_cache->getValueStorageSize()]();
+  const vector<InterpreterCache::ValueSlot>& slots = m_cache->getValueSlots();
+  for (unsigned i = 0; i < slots.size(); i++)
+  {
+    if (slots[i].size)
+    {
+      TypedValue value = {
+        slots[i].size, slots[i].num, m_valueStorage + slots[i].offset
+      };
+      m_values[i] = value;
+    }
+  }
+
+  m_privateMemory = new Memory(AddrSpacePrivate, sizeof(size_t)==8 ? 32 : 16,
+                               m_context);
+  m_position = new Position;
+
+  reset(lid);
+}
+
+WorkItem::~WorkItem()
+{
+  delete m_privateMemory;
+  delete m_position;
+  delete[] m_valueStorage;
+}
+
+void WorkItem::reset(Size3 lid)
 {
   m_localID = lid;
 
   // Compute global ID
-  Size3 groupID = workGroup->getGroupID();
-  Size3 groupSize = kernelInvocation->getLocalSize();
-  Size3 globalOffset = kernelInvocation->getGlobalOffset();
+  Size3 groupID = m_workGroup->getGroupID();
+  Size3 groupSize = m_kernelInvocation->getLocalSize();
+  Size3 globalOffset = m_kernelInvocation->getGlobalOffset();
   m_globalID.x = lid.x + groupID.x*groupSize.x + globalOffset.x;
   m_globalID.y = lid.y + groupID.y*groupSize.y + globalOffset.y;
   m_globalID.z = lid.z + groupID.z*groupSize.z + globalOffset.z;
 
-  Size3 globalSize = kernelInvocation->getGlobalSize();
+  Size3 globalSize = m_kernelInvocation->getGlobalSize();
   m_globalIndex = (m_globalID.x +
                   (m_globalID.y +
                    m_globalID.z*globalSize.y) * globalSize.x);
 
-  const Kernel *kernel = kernelInvocation->getKernel();
-
-  // Load interpreter cache
-  m_cache = kernel->getProgram()->getInterpreterCache(kernel->getFunction());
-
-  // Set initial number of values to store based on cache
-  m_values.resize(m_cache->getNumValues());
+  // Skip per-instruction notifications if no plugins need them
+  // Rechecked here, as work-items may be reused by uninstrumented groups
+  m_notifyInstructions = m_context->needsInstructionEvents() &&
+                         m_context->isInstrumented();
 
-  m_privateMemory = new Memory(AddrSpacePrivate, sizeof(size_t)==8 ? 32 : 16,
-                               m_context);
+  // Discard state left by a previous work-item, whose private memory was
+  // already released when it finished
+  m_pluginData.clear();
+  m_pool.reset();
+  m_tempPool.reset();
+  m_phiTemps.clear();
+  m_variables.clear();
+  m_constExprValues.assign(m_constExprValues.size(), TypedValue());
 
   // Initialise kernel arguments and global variables
+  const Kernel *kernel = m_kernelInvocation->getKernel();
   for (auto value  = kernel->values_begin();
             value != kernel->values_end();
             value++)
   {
     pair<unsigned,unsigned> size = getValueSize(value->first);
-    TypedValue v = {
-      size.first,
-      size.second,
-      m_pool.alloc(size.first*size.second)
-    };
+    TypedValue v = {size.first, size.second, NULL};
 
     const llvm::Type *type = value->first->getType();
     if (type->isPointerTy() &&
         type->getPointerAddressSpace() == AddrSpacePrivate)
     {
       size_t sz = value->second.size*value->second.num;
+      v.data = m_pool.alloc(v.size*v.num);
       v.setPointer(m_privateMemory->allocateBuffer(sz, 0, value->second.data));
     }
     else if (type->isPointerTy() &&
              type->getPointerAddressSpace() == AddrSpaceLocal)
     {
+      v.data = m_pool.alloc(v.size*v.num);
       v.setPointer(m_workGroup->getLocalMemoryAddress(value->first));
     }
     else
     {
-      memcpy(v.data, value->second.data, v.size*v.num);
+      // Values are never written in place, so share the kernel's copy
+      v.data = value->second.data;
     }
 
     setValue(value->first, v);
   }
 
   // Initialize interpreter state
-  m_state    = READY;
-  m_position = new Position;
+  m_state = READY;
+  *m_position = Position();
   m_position->hasBegun = false;
   m_position->prevBlock = NULL;
-  m_position->nextBlock = NULL;
+  m_position->nextInst = NULL;
   m_position->currBlock = &*kernel->getFunction()->begin();
-  m_position->currInst = m_position->currBlock->begin();
-}
-
-WorkItem::~WorkItem()
-{
-  delete m_privateMemory;
-  delete m_position;
+  m_position->currInst = m_cache->getEntryPoint(kernel->getFunction());
 }
 
 void WorkItem::clearBarrier()
@@ -130,208 +198,66 @@ void WorkItem::clearBarrier()
   }
 }
 
-void WorkItem::dispatch(const llvm::Instruction *instruction,
+void WorkItem::dispatch(const InterpreterCache::Instruction *instruction,
                         TypedValue& result)
 {
-  switch (instruction->getOpcode())
-  {
-  case llvm::Instruction::Add:
-    add(instruction, result);
-    break;
-  case llvm::Instruction::Alloca:
-    alloc(instruction, result);
-    break;
-  case llvm::Instruction::And:
-    bwand(instruction, result);
-    break;
-  case llvm::Instruction::AShr:
-    ashr(instruction, result);
-    break;
-  case llvm::Instruction::BitCast:
-    bitcast(instruction, result);
-    break;
-  case llvm::Instruction::Br:
-    br(instruction, result);
-    break;
-  case llvm::Instruction::Call:
-    call(instruction, result);
-    break;
-  case llvm::Instruction::ExtractElement:
-    extractelem(instruction, result);
-    break;
-  case llvm::Instruction::ExtractValue:
-    extractval(instruction, result);
-    break;
-  case llvm::Instruction::FAdd:
-    fadd(instruction, result);
-    break;
-  case llvm::Instruction::FCmp:
-    fcmp(instruction, result);
-    break;
-  case llvm::Instruction::FDiv:
-    fdiv(instruction, result);
-    break;
-  case llvm::Instruction::FMul:
-    fmul(instruction, result);
-    break;
-#if LLVM_VERSION >= 80
-  case llvm::Instruction::FNeg:
-    fneg(instruction, result);
-    break;
-#endif
-  case llvm::Instruction::FPExt:
-    fpext(instruction, result);
-    break;
-  case llvm::Instruction::FPToSI:
-    fptosi(instruction, result);
-    break;
-  case llvm::Instruction::FPToUI:
-    fptoui(instruction, result);
-    break;
-  case llvm::Instruction::FPTrunc:
-    fptrunc(instruction, result);
-    break;
-  case llvm::Instruction::FRem:
-    frem(instruction, result);
-    break;
-  case llvm::Instruction::FSub:
-    fsub(instruction, result);
-    break;
-  case llvm::Instruction::GetElementPtr:
-    gep(instruction, result);
-    break;
-  case llvm::Instruction::ICmp:
-    icmp(instruction, result);
-    break;
-  case llvm::Instruction::InsertElement:
-    insertelem(instruction, result);
-    break;
-  case llvm::Instruction::InsertValue:
-    insertval(instruction, result);
-    break;
-  case llvm::Instruction::IntToPtr:
-    inttoptr(instruction, result);
-    break;
-  case llvm::Instruction::Load:
-    load(instruction, result);
-    break;
-  case llvm::Instruction::LShr:
-    lshr(instruction, result);
-    break;
-  case llvm::Instruction::Mul:
-    mul(instruction, result);
-    break;
-  case llvm::Instruction::Or:
-    bwor(instruction, result);
-    break;
-  case llvm::Instruction::PHI:
-    phi(instruction, result);
-    break;
-  case llvm::Instruction::PtrToInt:
-    ptrtoint(instruction, result);
-    break;
-  case llvm::Instruction::Ret:
-    ret(instruction, result);
-    break;
-  case llvm::Instruction::SDiv:
-    sdiv(instruction, result);
-    break;
-  case llvm::Instruction::Select:
-    select(instruction, result);
-    break;
-  case llvm::Instruction::SExt:
-    sext(instruction, result);
-    break;
-  case llvm::Instruction::Shl:
-    shl(instruction, result);
-    break;
-  case llvm::Instruction::ShuffleVector:
-    shuffle(instruction, result);
-    break;
-  case llvm::Instruction::SIToFP:
-    sitofp(instruction, result);
-    break;
-  case llvm::Instruction::SRem:
-    srem(instruction, result);
-    break;
-  case llvm::Instruction::Store:
-    store(instruction, result);
-    break;
-  case llvm::Instruction::Sub:
-    sub(instruction, result);
-    break;
-  case llvm::Instruction::Switch:
-    swtch(instruction, result);
-    break;
-  case llvm::Instruction::Trunc:
-    itrunc(instruction, result);
-    break;
-  case llvm::Instruction::UDiv:
-    udiv(instruction, result);
-    break;
-  case llvm::Instruction::UIToFP:
-    uitofp(instruction, result);
-    break;
-  case llvm::Instruction::URem:
-    urem(instruction, result);
-    break;
-  case llvm::Instruction::Unreachable:
-    FATAL_ERROR("Encountered unreachable instruction");
-  case llvm::Instruction::Xor:
-    bwxor(instruction, result);
-    break;
-  case llvm::Instruction::ZExt:
-    zext(instruction, result);
-    break;
-  default:
-    FATAL_ERROR("Unsupported instruction: %s", instruction->getOpcodeName());
-  }
+  (this->*instruction->handler)(instruction, result);
 }
 
-void WorkItem::execute(const llvm::Instruction *instruction)
+void WorkItem::execute(const InterpreterCache::Instruction *instruction)
 {
-  // Prepare private variable for instruction result
-  pair<unsigned,unsigned> resultSize = getValueSize(instruction);
+  bool isPhi = instruction->opcode == llvm::Instruction::PHI;
+  if (!isPhi && !m_phiTemps.empty())
+  {
+    // Commit results of preceding phi nodes
+    for (auto temp = m_phiTemps.begin(); temp != m_phiTemps.end(); temp++)
+    {
+      memcpy(m_values[temp->first].data, temp->second.data,
+             temp->second.size*temp->second.num);
+    }
+    m_phiTemps.clear();
+  }
+
+  // Release temporaries from previous instructions
+  if (m_phiTemps.empty())
+  {
+    m_tempPool.reset();
+  }
 
-  // Prepare result
+  // Prepare result, writing directly to the value's storage slot unless
+  // the value is a phi node that must not be updated until the block starts
   TypedValue result = {
-    resultSize.first,
-    resultSize.second,
+    instruction->resultSize,
+    instruction->resultNum,
     NULL
   };
   if (result.size)
   {
-    result.data = m_pool.alloc(result.size*result.num);
-  }
-
-  if (instruction->getOpcode() != llvm::Instruction::PHI &&
-      m_phiTemps.size() > 0)
-  {
-    TypedValueMap::iterator itr;
-    for (itr = m_phiTemps.begin(); itr != m_phiTemps.end(); itr++)
-    {
-      setValue(itr->first, itr->second);
-    }
-    m_phiTemps.clear();
+    if (isPhi)
+      result.data = m_tempPool.alloc(result.size*result.num);
+    else
+      result.data = m_values[instruction->id].data;
   }
 
   // Execute instruction
   dispatch(instruction, result);
 
-  // Store result
-  if (result.size)
+  if (result.size && isPhi)
   {
-    if (instruction->getOpcode() != llvm::Instruction::PHI)
-    {
-      setValue(instruction, result);
-    }
-    else
-    {
-      m_phiTemps[instruction] = result;
-    }
+    m_phiTemps.push_back(make_pair(instruction->id, result));
+  }
+
+  if (m_notifyInstructions)
+  {
+    m_context->notifyInstructionExecuted(this, instruction->instruction,
+                                         result);
   }
+}
 
-  m_context->notifyInstructionExecuted(this, instruction, result);
+TypedValue WorkItem::getCallArgument(unsigned index) const
+{
+  // Arguments of the current call, using its pre-decoded operands
+  return getOperand(m_position->currInst->operands[index]);
 }
 
 const stack<const llvm::Instruction*>& WorkItem::getCallStack() const
@@ -344,9 +270,15 @@ const llvm::BasicBlock* WorkItem::getCurrentBlock() const
   return m_position->currBlock;
 }
 
+const InterpreterCache::Instruction*
+WorkItem::getCurrentDecodedInstruction() const
+{
+  return m_position->currInst;
+}
+
 const llvm::Instruction* WorkItem::getCurrentInstruction() const
 {
-  return &*m_position->currInst;
+  return m_position->currInst->instruction;
 }
 
 Size3 WorkItem::getGlobalID() const
@@ -403,28 +335,9 @@ TypedValue WorkItem::getOperand(const llvm::Value *operand) const
   //}
   else if (valID == llvm::Value::ConstantExprVal)
   {
-    pair<unsigned,unsigned> size = getValueSize(operand);
-    TypedValue result;
-    result.size = size.first;
-    result.num  = size.second;
-    result.data = m_pool.alloc(getTypeSize(operand->getType()));
-
-    // Use of const_cast here is ugly, but ConstExpr instructions
-    // shouldn't actually modify WorkItem state anyway
-    const_cast<WorkItem*>(this)->dispatch(
-      m_cache->getConstantExpr(operand), result);
-    return result;
-  }
-  else if (valID == llvm::Value::UndefValueVal            ||
-           valID == llvm::Value::ConstantAggregateZeroVal ||
-           valID == llvm::Value::ConstantDataArrayVal     ||
-           valID == llvm::Value::ConstantDataVectorVal    ||
-           valID == llvm::Value::ConstantIntVal           ||
-           valID == llvm::Value::ConstantFPVal            ||
-           valID == llvm::Value::ConstantArrayVal         ||
-           valID == llvm::Value::ConstantStructVal        ||
-           valID == llvm::Value::ConstantVectorVal        ||
-           valID == llvm::Value::ConstantPointerNullVal)
+    return getOperand(m_cache->getConstantExpr(operand));
+  }
+  else if (isCachedConstant(valID))
   {
     return m_cache->getConstant(operand);
   }
@@ -452,6 +365,59 @@ TypedValue WorkItem::getOperand(const llvm::Value *operand) const
   assert(false);
 }
 
+TypedValue WorkItem::getOperand(const InterpreterCache::Operand& operand) const
+{
+  switch (operand.type)
+  {
+  case InterpreterCache::Operand::VALUE:
+    return m_values[operand.id];
+  case InterpreterCache::Operand::CONSTANT:
+    return operand.constant;
+  case InterpreterCache::Operand::CONSTANT_EXPR:
+  {
+    // Evaluate expression on first use by this work-item
+    TypedValue& cached = m_constExprValues[operand.expr->id];
+    if (!cached.data)
+    {
+      cached = evaluateConstantExpr(operand);
+    }
+    return cached;
+  }
+  case InterpreterCache::Operand::GROUP_CONSTANT_EXPR:
+  {
+    // Evaluate expression on first use by any work-item in the work-group
+    TypedValue cached = m_workGroup->getConstantExprValue(operand.expr->id);
+    if (!cached.data)
+    {
+      cached = evaluateConstantExpr(operand);
+      m_workGroup->setConstantExprValue(operand.expr->id, cached);
+    }
+    return cached;
+  }
+  default:
+    FATAL_ERROR("Unhandled operand type: %d", operand.type);
+  }
+}
+
+TypedValue WorkItem::evaluateConstantExpr(
+  const InterpreterCache::Operand& operand) const
+{
+  TypedValue result;
+  result.size = operand.expr->resultSize;
+  result.num  = operand.expr->resultNum;
+  result.data = m_pool.alloc(getTypeSize(operand.value->getType()));
+
+  // Use of const_cast here is ugly, but ConstExpr instructions
+  // shouldn't actually modify WorkItem state anyway
+  const_cast<WorkItem*>(this)->dispatch(operand.expr, result);
+  return result;
+}
+
+void* WorkItem::getPluginData(unsigned index) const
+{
+  return m_pluginData.get(index);
+}
+
 const llvm::BasicBlock* WorkItem::getPreviousBlock() const
 {
   return m_position->prevBlock;
@@ -720,6 +686,11 @@ bool WorkItem::printValue(const llvm::Value *value) const
   return true;
 }
 
+void WorkItem::setPluginData(unsigned index, void *data) const
+{
+  m_pluginData.set(index, data);
+}
+
 void WorkItem::setValue(const llvm::Value *key, TypedValue value)
 {
   m_values[m_cache->getValueID(key)] = value;
@@ -736,25 +707,30 @@ WorkItem::State WorkItem::step()
   }
 
   // Execute the next instruction
-  execute(&*m_position->currInst);
+  execute(m_position->currInst);
 
-  // Check if we've reached the end of the block
-  if (++m_position->currInst == m_position->currBlock->end() ||
-      m_position->nextBlock)
+  if (m_position->nextInst)
   {
-    if (m_position->nextBlock)
-    {
-      // Move to next basic block
-      m_position->prevBlock = m_position->currBlock;
-      m_position->currBlock = m_position->nextBlock;
-      m_position->nextBlock = NULL;
-      m_position->currInst  = m_position->currBlock->begin();
-    }
+    // Move to next basic block
+    m_position->prevBlock = m_position->currBlock;
+    m_position->currInst  = m_position->nextInst;
+    m_position->currBlock = m_position->currInst->instruction->getParent();
+    m_position->nextInst  = NULL;
+  }
+  else if (m_state != FINISHED)
+  {
+    // Move to next instruction in decoded stream
+    m_position->currInst++;
   }
 
   if (m_state == FINISHED)
+  {
     m_context->notifyWorkItemComplete(this);
 
+    // Release private memory while this is still the current work-item
+    m_privateMemory->clear();
+  }
+
   return m_state;
 }
 
@@ -764,12 +740,13 @@ WorkItem::State WorkItem::step()
 ///////////////////////////////
 
 #define INSTRUCTION(name) \
-  void WorkItem::name(const llvm::Instruction *instruction, TypedValue& result)
+  void WorkItem::name(const InterpreterCache::Instruction *instruction, \
+                      TypedValue& result)
 
 INSTRUCTION(add)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt(opA.getUInt(i) + opB.getUInt(i), i);
@@ -778,7 +755,8 @@ INSTRUCTION(add)
 
 INSTRUCTION(alloc)
 {
-  const llvm::AllocaInst *allocInst = ((const llvm::AllocaInst*)instruction);
+  const llvm::AllocaInst *allocInst =
+    (const llvm::AllocaInst*)instruction->instruction;
   const llvm::Type *type = allocInst->getAllocatedType();
 
   // Perform allocation
@@ -797,8 +775,8 @@ INSTRUCTION(alloc)
 
 INSTRUCTION(ashr)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   uint64_t shiftMask =
     (result.num > 1 ? result.size : max((size_t)result.size, sizeof(uint32_t)))
     * 8 - 1;
@@ -810,31 +788,29 @@ INSTRUCTION(ashr)
 
 INSTRUCTION(bitcast)
 {
-  TypedValue operand = getOperand(instruction->getOperand(0));
+  TypedValue operand = getOperand(instruction->operands[0]);
   memcpy(result.data, operand.data, result.size*result.num);
 }
 
 INSTRUCTION(br)
 {
-  if (instruction->getNumOperands() == 1)
+  if (instruction->targets.size() == 1)
   {
     // Unconditional branch
-    m_position->nextBlock = (const llvm::BasicBlock*)instruction->getOperand(0);
+    m_position->nextInst = instruction->targets[0];
   }
   else
   {
     // Conditional branch
-    bool pred = getOperand(instruction->getOperand(0)).getUInt();
-    const llvm::Value *iftrue = instruction->getOperand(2);
-    const llvm::Value *iffalse = instruction->getOperand(1);
-    m_position->nextBlock = (const llvm::BasicBlock*)(pred ? iftrue : iffalse);
+    bool pred = getOperand(instruction->operands[0]).getUInt();
+    m_position->nextInst = instruction->targets[pred ? 0 : 1];
   }
 }
 
 INSTRUCTION(bwand)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt(opA.getUInt(i) & opB.getUInt(i), i);
@@ -843,8 +819,8 @@ INSTRUCTION(bwand)
 
 INSTRUCTION(bwor)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt(opA.getUInt(i) | opB.getUInt(i), i);
@@ -853,8 +829,8 @@ INSTRUCTION(bwor)
 
 INSTRUCTION(bwxor)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt(opA.getUInt(i) ^ opB.getUInt(i), i);
@@ -863,32 +839,27 @@ INSTRUCTION(bwxor)
 
 INSTRUCTION(call)
 {
-  const llvm::CallInst *callInst = (const llvm::CallInst*)instruction;
-  const llvm::Function *function = callInst->getCalledFunction();
-
-  // Check for indirect function calls
-  if (!callInst->getCalledFunction())
-  {
-    // Resolve indirect function pointer
-    const llvm::Value *func = callInst->getCalledValue();
-    const llvm::Value *funcPtr = ((const llvm::User*)func)->getOperand(0);
-    function = (const llvm::Function*)funcPtr;
-  }
+  const llvm::CallInst *callInst =
+    (const llvm::CallInst*)instruction->instruction;
 
   // Check if function has definition
-  if (!function->isDeclaration())
+  if (!instruction->targets.empty())
   {
-    m_position->callStack.push(&*m_position->currInst);
+    const llvm::Function *function =
+      instruction->targets[0]->instruction->getFunction();
+
+    m_position->callStack.push(callInst);
+    m_position->returnStack.push(instruction);
     m_position->allocations.push(list<size_t>());
-    m_position->nextBlock = &*function->begin();
+    m_position->nextInst = instruction->targets[0];
 
     // Set function arguments
     llvm::Function::const_arg_iterator argItr;
     for (argItr = function->arg_begin();
          argItr != function->arg_end(); argItr++)
     {
-      const llvm::Value *arg = callInst->getArgOperand(argItr->getArgNo());
-      TypedValue value = getOperand(arg);
+      unsigned argNo = argItr->getArgNo();
+      TypedValue value = getOperand(instruction->operands[argNo]);
 
       if (argItr->hasByValAttr())
       {
@@ -899,44 +870,36 @@ INSTRUCTION(call)
         m_position->allocations.top().push_back(ptr);
 
         // Pass new allocation to function
-        TypedValue address =
-        {
-          sizeof(size_t),
-          1,
-          m_pool.alloc(sizeof(size_t))
-        };
-        address.setPointer(ptr);
-        setValue(&*argItr, address);
+        m_values[instruction->args[argNo]].setPointer(ptr);
       }
       else
       {
-        setValue(&*argItr, m_pool.clone(value));
+        memcpy(m_values[instruction->args[argNo]].data, value.data,
+               value.size*value.num);
       }
     }
 
     return;
   }
 
-  // Call builtin function
-  InterpreterCache::Builtin builtin = m_cache->getBuiltin(function);
-  builtin.function.func(this, callInst,
-                        builtin.name, builtin.overload,
-                        result, builtin.function.op);
+  // Call builtin function resolved when decoding
+  const InterpreterCache::Builtin *builtin = instruction->builtin;
+  builtin->function.func(this, callInst,
+                         builtin->name, builtin->overload,
+                         result, builtin->function.op);
 }
 
 INSTRUCTION(extractelem)
 {
-  const llvm::ExtractElementInst *extract =
-    (const llvm::ExtractElementInst*)instruction;
-  unsigned index     = getOperand(extract->getIndexOperand()).getUInt();
-  TypedValue operand = getOperand(extract->getVectorOperand());
+  unsigned index     = getOperand(instruction->operands[1]).getUInt();
+  TypedValue operand = getOperand(instruction->operands[0]);
   memcpy(result.data, operand.data + result.size*index, result.size);
 }
 
 INSTRUCTION(extractval)
 {
   const llvm::ExtractValueInst *extract =
-    (const llvm::ExtractValueInst*)instruction;
+    (const llvm::ExtractValueInst*)instruction->instruction;
   const llvm::Value *agg = extract->getAggregateOperand();
   llvm::ArrayRef<unsigned int> indices = extract->getIndices();
 
@@ -963,13 +926,14 @@ INSTRUCTION(extractval)
   }
 
   // Copy target value to result
-  memcpy(result.data, getOperand(agg).data + offset, getTypeSize(type));
+  memcpy(result.data, getOperand(instruction->operands[0]).data + offset,
+         getTypeSize(type));
 }
 
 INSTRUCTION(fadd)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setFloat(opA.getFloat(i) + opB.getFloat(i), i);
@@ -978,11 +942,12 @@ INSTRUCTION(fadd)
 
 INSTRUCTION(fcmp)
 {
-  const llvm::CmpInst *cmpInst = (const llvm::CmpInst*)instruction;
+  const llvm::CmpInst *cmpInst =
+    (const llvm::CmpInst*)instruction->instruction;
   llvm::CmpInst::Predicate pred = cmpInst->getPredicate();
 
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
 
   uint64_t t = result.num > 1 ? -1 : 1;
   for (unsigned i = 0; i < result.num; i++)
@@ -1041,8 +1006,8 @@ INSTRUCTION(fcmp)
 
 INSTRUCTION(fdiv)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setFloat(opA.getFloat(i) / opB.getFloat(i), i);
@@ -1051,8 +1016,8 @@ INSTRUCTION(fdiv)
 
 INSTRUCTION(fmul)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setFloat(opA.getFloat(i) * opB.getFloat(i), i);
@@ -1062,7 +1027,7 @@ INSTRUCTION(fmul)
 #if LLVM_VERSION >= 80
 INSTRUCTION(fneg)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setFloat(-op.getFloat(i), i);
@@ -1072,7 +1037,7 @@ INSTRUCTION(fneg)
 
 INSTRUCTION(fpext)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setFloat(op.getFloat(i), i);
@@ -1081,7 +1046,7 @@ INSTRUCTION(fpext)
 
 INSTRUCTION(fptosi)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setSInt((int64_t)op.getFloat(i), i);
@@ -1090,7 +1055,7 @@ INSTRUCTION(fptosi)
 
 INSTRUCTION(fptoui)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt((uint64_t)op.getFloat(i), i);
@@ -1099,8 +1064,8 @@ INSTRUCTION(fptoui)
 
 INSTRUCTION(frem)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setFloat(fmod(opA.getFloat(i), opB.getFloat(i)), i);
@@ -1109,7 +1074,7 @@ INSTRUCTION(frem)
 
 INSTRUCTION(fptrunc)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setFloat(op.getFloat(i), i);
@@ -1118,8 +1083,8 @@ INSTRUCTION(fptrunc)
 
 INSTRUCTION(fsub)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setFloat(opA.getFloat(i) - opB.getFloat(i), i);
@@ -1129,18 +1094,17 @@ INSTRUCTION(fsub)
 INSTRUCTION(gep)
 {
   const llvm::GetElementPtrInst *gepInst =
-    (const llvm::GetElementPtrInst*)instruction;
+    (const llvm::GetElementPtrInst*)instruction->instruction;
 
   // Get base address
-  size_t base = getOperand(gepInst->getPointerOperand()).getPointer();
+  size_t base = getOperand(instruction->operands[0]).getPointer();
   const llvm::Type *ptrType = gepInst->getPointerOperandType();
 
   // Get indices
   std::vector<int64_t> offsets;
-  llvm::User::const_op_iterator opItr;
-  for (opItr = gepInst->idx_begin(); opItr != gepInst->idx_end(); opItr++)
+  for (unsigned i = 1; i < instruction->operands.size(); i++)
   {
-    offsets.push_back(getOperand(opItr->get()).getSInt());
+    offsets.push_back(getOperand(instruction->operands[i]).getSInt());
   }
 
   result.setPointer(resolveGEP(base, ptrType, offsets));
@@ -1148,11 +1112,12 @@ INSTRUCTION(gep)
 
 INSTRUCTION(icmp)
 {
-  const llvm::CmpInst *cmpInst = (const llvm::CmpInst*)instruction;
+  const llvm::CmpInst *cmpInst =
+    (const llvm::CmpInst*)instruction->instruction;
   llvm::CmpInst::Predicate pred = cmpInst->getPredicate();
 
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
 
   uint64_t t = result.num > 1 ? -1 : 1;
   for (unsigned i = 0; i < result.num; i++)
@@ -1206,9 +1171,9 @@ INSTRUCTION(icmp)
 
 INSTRUCTION(insertelem)
 {
-  TypedValue vector  = getOperand(instruction->getOperand(0));
-  TypedValue element = getOperand(instruction->getOperand(1));
-  unsigned index     = getOperand(instruction->getOperand(2)).getUInt();
+  TypedValue vector  = getOperand(instruction->operands[0]);
+  TypedValue element = getOperand(instruction->operands[1]);
+  unsigned index     = getOperand(instruction->operands[2]).getUInt();
   memcpy(result.data, vector.data, result.size*result.num);
   memcpy(result.data + index*result.size, element.data, result.size);
 }
@@ -1216,11 +1181,12 @@ INSTRUCTION(insertelem)
 INSTRUCTION(insertval)
 {
   const llvm::InsertValueInst *insert =
-    (const llvm::InsertValueInst*)instruction;
+    (const llvm::InsertValueInst*)instruction->instruction;
 
   // Load original aggregate data
   const llvm::Value *agg = insert->getAggregateOperand();
-  memcpy(result.data, getOperand(agg).data, result.size*result.num);
+  memcpy(result.data, getOperand(instruction->operands[0]).data,
+         result.size*result.num);
 
   // Compute offset for inserted value
   int offset = 0;
@@ -1247,13 +1213,13 @@ INSTRUCTION(insertval)
 
   // Copy inserted value into result
   const llvm::Value *value = insert->getInsertedValueOperand();
-  memcpy(result.data + offset, getOperand(value).data,
+  memcpy(result.data + offset, getOperand(instruction->operands[1]).data,
          getTypeSize(value->getType()));
 }
 
 INSTRUCTION(inttoptr)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setPointer(op.getUInt(i), i);
@@ -1262,7 +1228,7 @@ INSTRUCTION(inttoptr)
 
 INSTRUCTION(itrunc)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt(op.getUInt(i), i);
@@ -1271,10 +1237,11 @@ INSTRUCTION(itrunc)
 
 INSTRUCTION(load)
 {
-  const llvm::LoadInst *loadInst = (const llvm::LoadInst*)instruction;
+  const llvm::LoadInst *loadInst =
+    (const llvm::LoadInst*)instruction->instruction;
   unsigned addressSpace = loadInst->getPointerAddressSpace();
   const llvm::Value *opPtr = loadInst->getPointerOperand();
-  size_t address = getOperand(opPtr).getPointer();
+  size_t address = getOperand(instruction->operands[0]).getPointer();
 
   // Check address is correctly aligned
   unsigned alignment = loadInst->getAlignment();
@@ -1292,8 +1259,8 @@ INSTRUCTION(load)
 
 INSTRUCTION(lshr)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   uint64_t shiftMask =
     (result.num > 1 ? result.size : max((size_t)result.size, sizeof(uint32_t)))
     * 8 - 1;
@@ -1305,8 +1272,8 @@ INSTRUCTION(lshr)
 
 INSTRUCTION(mul)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt(opA.getUInt(i) * opB.getUInt(i), i);
@@ -1315,15 +1282,22 @@ INSTRUCTION(mul)
 
 INSTRUCTION(phi)
 {
-  const llvm::PHINode *phiNode = (const llvm::PHINode*)instruction;
-  const llvm::Value *value = phiNode->getIncomingValueForBlock(
-    (const llvm::BasicBlock*)m_position->prevBlock);
-  memcpy(result.data, getOperand(value).data, result.size*result.num);
+  const llvm::PHINode *phiNode =
+    (const llvm::PHINode*)instruction->instruction;
+
+  // Find incoming value for previous block
+  unsigned i = 0;
+  while (phiNode->getIncomingBlock(i) != m_position->prevBlock)
+  {
+    i++;
+  }
+  memcpy(result.data, getOperand(instruction->operands[i]).data,
+         result.size*result.num);
 }
 
 INSTRUCTION(ptrtoint)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt(op.getPointer(i), i);
@@ -1332,26 +1306,25 @@ INSTRUCTION(ptrtoint)
 
 INSTRUCTION(ret)
 {
-  const llvm::ReturnInst *retInst = (const llvm::ReturnInst*)instruction;
-
   if (!m_position->callStack.empty())
   {
-    m_position->currInst =
-      llvm::BasicBlock::const_iterator(m_position->callStack.top());
-    m_position->currBlock = m_position->currInst->getParent();
+    m_position->currInst = m_position->returnStack.top();
+    m_position->currBlock = m_position->currInst->instruction->getParent();
     m_position->callStack.pop();
+    m_position->returnStack.pop();
 
     // Set return value
-    const llvm::Value *returnVal = retInst->getReturnValue();
-    if (returnVal)
+    if (!instruction->operands.empty())
     {
-      setValue(&*m_position->currInst, m_pool.clone(getOperand(returnVal)));
+      TypedValue value = getOperand(instruction->operands[0]);
+      memcpy(m_values[m_position->currInst->id].data, value.data,
+             value.size*value.num);
     }
 
-    // Clear stack allocations
+    // Clear stack allocations, most recent first
     list<size_t>& allocs = m_position->allocations.top();
-    list<size_t>::iterator itr;
-    for (itr = allocs.begin(); itr != allocs.end(); itr++)
+    list<size_t>::reverse_iterator itr;
+    for (itr = allocs.rbegin(); itr != allocs.rend(); itr++)
     {
       m_privateMemory->deallocateBuffer(*itr);
     }
@@ -1359,7 +1332,7 @@ INSTRUCTION(ret)
   }
   else
   {
-    m_position->nextBlock = NULL;
+    m_position->nextInst = NULL;
     m_state = FINISHED;
     m_workGroup->notifyFinished(this);
   }
@@ -1367,8 +1340,8 @@ INSTRUCTION(ret)
 
 INSTRUCTION(sdiv)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     int64_t a = opA.getSInt(i);
@@ -1384,17 +1357,18 @@ INSTRUCTION(sdiv)
 
 INSTRUCTION(select)
 {
-  const llvm::SelectInst *selectInst = (const llvm::SelectInst*)instruction;
-  TypedValue opCondition = getOperand(selectInst->getCondition());
+  const llvm::SelectInst *selectInst =
+    (const llvm::SelectInst*)instruction->instruction;
+  TypedValue opCondition = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     const bool cond =
       selectInst->getCondition()->getType()->isVectorTy() ?
       opCondition.getUInt(i) :
       opCondition.getUInt();
-    const llvm::Value *op = cond ?
-      selectInst->getTrueValue() :
-      selectInst->getFalseValue();
+    const InterpreterCache::Operand& op = cond ?
+      instruction->operands[1] :
+      instruction->operands[2];
     memcpy(result.data + i*result.size,
            getOperand(op).data + i*result.size,
            result.size);
@@ -1403,8 +1377,8 @@ INSTRUCTION(select)
 
 INSTRUCTION(sext)
 {
-  const llvm::Value *operand = instruction->getOperand(0);
-  TypedValue value = getOperand(operand);
+  const llvm::Value *operand = instruction->instruction->getOperand(0);
+  TypedValue value = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     int64_t val = value.getSInt(i);
@@ -1418,8 +1392,8 @@ INSTRUCTION(sext)
 
 INSTRUCTION(shl)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   uint64_t shiftMask =
     (result.num > 1 ? result.size : max((size_t)result.size, sizeof(uint32_t)))
     * 8 - 1;
@@ -1432,11 +1406,10 @@ INSTRUCTION(shl)
 INSTRUCTION(shuffle)
 {
   const llvm::ShuffleVectorInst *shuffle =
-    (const llvm::ShuffleVectorInst*)instruction;
+    (const llvm::ShuffleVectorInst*)instruction->instruction;
 
   const llvm::Value *v1 = shuffle->getOperand(0);
-  const llvm::Value *v2 = shuffle->getOperand(1);
-  TypedValue mask = getOperand(shuffle->getMask());
+  TypedValue mask = getOperand(instruction->operands[2]);
 
   unsigned num = v1->getType()->getVectorNumElements();
   for (unsigned i = 0; i < result.num; i++)
@@ -1448,21 +1421,21 @@ INSTRUCTION(shuffle)
       continue;
     }
 
-    const llvm::Value *src = v1;
+    const InterpreterCache::Operand *src = &instruction->operands[0];
     unsigned int index = mask.getUInt(i);
     if (index >= num)
     {
       index -= num;
-      src = v2;
+      src = &instruction->operands[1];
     }
     memcpy(result.data + i*result.size,
-           getOperand(src).data + index*result.size, result.size);
+           getOperand(*src).data + index*result.size, result.size);
   }
 }
 
 INSTRUCTION(sitofp)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setFloat(op.getSInt(i), i);
@@ -1471,8 +1444,8 @@ INSTRUCTION(sitofp)
 
 INSTRUCTION(srem)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     int64_t a = opA.getSInt(i);
@@ -1488,10 +1461,11 @@ INSTRUCTION(srem)
 
 INSTRUCTION(store)
 {
-  const llvm::StoreInst *storeInst = (const llvm::StoreInst*)instruction;
+  const llvm::StoreInst *storeInst =
+    (const llvm::StoreInst*)instruction->instruction;
   unsigned addressSpace = storeInst->getPointerAddressSpace();
   const llvm::Value *opPtr = storeInst->getPointerOperand();
-  size_t address = getOperand(opPtr).getPointer();
+  size_t address = getOperand(instruction->operands[1]).getPointer();
 
   // Check address is correctly aligned
   unsigned alignment = storeInst->getAlignment();
@@ -1504,15 +1478,15 @@ INSTRUCTION(store)
   }
 
   // Store data
-  TypedValue operand = getOperand(storeInst->getValueOperand());
+  TypedValue operand = getOperand(instruction->operands[0]);
   getMemory(addressSpace)->store(operand.data, address,
                                  operand.size*operand.num);
 }
 
 INSTRUCTION(sub)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt(opA.getUInt(i) - opB.getUInt(i), i);
@@ -1521,28 +1495,28 @@ INSTRUCTION(sub)
 
 INSTRUCTION(swtch)
 {
-  const llvm::SwitchInst *swtch = (const llvm::SwitchInst*)instruction;
-  const llvm::Value *cond = swtch->getCondition();
-  uint64_t val = getOperand(cond).getUInt();
+  const llvm::SwitchInst *swtch =
+    (const llvm::SwitchInst*)instruction->instruction;
+  uint64_t val = getOperand(instruction->operands[0]).getUInt();
 
   // Look for case matching condition value
   for (auto C : swtch->cases())
   {
     if (C.getCaseValue()->getZExtValue() == val)
     {
-      m_position->nextBlock = C.getCaseSuccessor();
+      m_position->nextInst = instruction->targets[C.getSuccessorIndex()];
       return;
     }
   }
 
   // No matching cases - use default
-  m_position->nextBlock = swtch->getDefaultDest();
+  m_position->nextInst = instruction->targets[0];
 }
 
 INSTRUCTION(udiv)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     uint64_t a = opA.getUInt(i);
@@ -1553,7 +1527,7 @@ INSTRUCTION(udiv)
 
 INSTRUCTION(uitofp)
 {
-  TypedValue op = getOperand(instruction->getOperand(0));
+  TypedValue op = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     uint64_t in = op.getUInt(i);
@@ -1564,10 +1538,21 @@ INSTRUCTION(uitofp)
   }
 }
 
+INSTRUCTION(unreachable)
+{
+  FATAL_ERROR("Encountered unreachable instruction");
+}
+
+INSTRUCTION(unsupported)
+{
+  FATAL_ERROR("Unsupported instruction: %s",
+              instruction->instruction->getOpcodeName());
+}
+
 INSTRUCTION(urem)
 {
-  TypedValue opA = getOperand(instruction->getOperand(0));
-  TypedValue opB = getOperand(instruction->getOperand(1));
+  TypedValue opA = getOperand(instruction->operands[0]);
+  TypedValue opB = getOperand(instruction->operands[1]);
   for (unsigned i = 0; i < result.num; i++)
   {
     uint64_t a = opA.getUInt(i);
@@ -1578,15 +1563,246 @@ INSTRUCTION(urem)
 
 INSTRUCTION(zext)
 {
-  TypedValue operand = getOperand(instruction->getOperand(0));
+  TypedValue operand = getOperand(instruction->operands[0]);
   for (unsigned i = 0; i < result.num; i++)
   {
     result.setUInt(operand.getUInt(i), i);
   }
 }
 
+
+
+/////////////////////////////////////////////
+//// Type-specialized instruction handlers ////
+/////////////////////////////////////////////
+
+namespace
+{
+  // Storage for half-precision values, which are computed in single-precision
+  struct half_t
+  {
+    uint16_t bits;
+
+    operator float() const
+    {
+      return halfToFloat(bits);
+    }
+    half_t& operator=(float value)
+    {
+      bits = floatToHalf(value, Half_RTE);
+      return *this;
+    }
+  };
+
+  // Type used to compute results for each element storage type
+  template<typename T> struct ComputeType { typedef T type; };
+  template<> struct ComputeType<uint8_t> { typedef uint32_t type; };
+  template<> struct ComputeType<uint16_t> { typedef uint32_t type; };
+  template<> struct ComputeType<half_t> { typedef float type; };
+}
+
+template<typename T, unsigned N, template<typename> class Op>
+INSTRUCTION(binop)
+{
+  typedef typename ComputeType<T>::type C;
+  const T *a = (const T*)getOperand(instruction->operands[0]).data;
+  const T *b = (const T*)getOperand(instruction->operands[1]).data;
+  T *r = (T*)result.data;
+  for (unsigned i = 0; i < N; i++)
+  {
+    r[i] = Op<C>()(a[i], b[i]);
+  }
+}
+
+template<typename T, unsigned N, template<typename> class Op>
+INSTRUCTION(cmpop)
+{
+  typedef typename ComputeType<T>::type C;
+  const T *a = (const T*)getOperand(instruction->operands[0]).data;
+  const T *b = (const T*)getOperand(instruction->operands[1]).data;
+  uint8_t *r = (uint8_t*)result.data;
+  for (unsigned i = 0; i < N; i++)
+  {
+    r[i] = Op<C>()(a[i], b[i]) ? (N > 1 ? 0xFF : 1) : 0;
+  }
+}
+
 #undef INSTRUCTION
 
+struct WorkItem::SpecializedHandlers
+{
+  typedef InterpreterCache::InstructionHandler Handler;
+
+  template<typename T, template<typename> class Op>
+  static Handler binop(unsigned num)
+  {
+    switch (num)
+    {
+    case 1:  return &WorkItem::binop<T, 1, Op>;
+    case 2:  return &WorkItem::binop<T, 2, Op>;
+    case 3:  return &WorkItem::binop<T, 3, Op>;
+    case 4:  return &WorkItem::binop<T, 4, Op>;
+    case 8:  return &WorkItem::binop<T, 8, Op>;
+    case 16: return &WorkItem::binop<T, 16, Op>;
+    default: return NULL;
+    }
+  }
+
+  template<typename T, template<typename> class Op>
+  static Handler cmpop(unsigned num)
+  {
+    switch (num)
+    {
+    case 1:  return &WorkItem::cmpop<T, 1, Op>;
+    case 2:  return &WorkItem::cmpop<T, 2, Op>;
+    case 3:  return &WorkItem::cmpop<T, 3, Op>;
+    case 4:  return &WorkItem::cmpop<T, 4, Op>;
+    case 8:  return &WorkItem::cmpop<T, 8, Op>;
+    case 16: return &WorkItem::cmpop<T, 16, Op>;
+    default: return NULL;
+    }
+  }
+
+  template<template<typename> class Op>
+  static Handler intBinop(unsigned size, unsigned num)
+  {
+    switch (size)
+    {
+    case 1: return binop<uint8_t, Op>(num);
+    case 2: return binop<uint16_t, Op>(num);
+    case 4: return binop<uint32_t, Op>(num);
+    case 8: return binop<uint64_t, Op>(num);
+    default: return NULL;
+    }
+  }
+
+  template<template<typename> class Op>
+  static Handler floatBinop(unsigned size, unsigned num)
+  {
+    switch (size)
+    {
+    case 2: return binop<half_t, Op>(num);
+    case 4: return binop<float, Op>(num);
+    case 8: return binop<double, Op>(num);
+    default: return NULL;
+    }
+  }
+
+  template<template<typename> class Op>
+  static Handler intCmp(bool isSigned, unsigned size, unsigned num)
+  {
+    switch (size)
+    {
+    case 1: return isSigned ? cmpop<int8_t, Op>(num) : cmpop<uint8_t, Op>(num);
+    case 2: return isSigned ? cmpop<int16_t, Op>(num)
+                            : cmpop<uint16_t, Op>(num);
+    case 4: return isSigned ? cmpop<int32_t, Op>(num)
+                            : cmpop<uint32_t, Op>(num);
+    case 8: return isSigned ? cmpop<int64_t, Op>(num)
+                            : cmpop<uint64_t, Op>(num);
+    default: return NULL;
+    }
+  }
+
+  template<template<typename> class Op>
+  static Handler floatCmp(unsigned size, unsigned num)
+  {
+    switch (size)
+    {
+    case 2: return cmpop<half_t, Op>(num);
+    case 4: return cmpop<float, Op>(num);
+    case 8: return cmpop<double, Op>(num);
+    default: return NULL;
+    }
+  }
+
+  // Returns a handler specialized for the element type and vector width of
+  // an instruction, or NULL if the generic handler should be used
+  static Handler get(const InterpreterCache::Instruction& decoded)
+  {
+    unsigned size = decoded.resultSize;
+    unsigned num = decoded.resultNum;
+    switch (decoded.opcode)
+    {
+    case llvm::Instruction::Add:
+      return intBinop<std::plus>(size, num);
+    case llvm::Instruction::Sub:
+      return intBinop<std::minus>(size, num);
+    case llvm::Instruction::Mul:
+      return intBinop<std::multiplies>(size, num);
+    case llvm::Instruction::And:
+      return intBinop<std::bit_and>(size, num);
+    case llvm::Instruction::Or:
+      return intBinop<std::bit_or>(size, num);
+    case llvm::Instruction::Xor:
+      return intBinop<std::bit_xor>(size, num);
+    case llvm::Instruction::FAdd:
+      return floatBinop<std::plus>(size, num);
+    case llvm::Instruction::FSub:
+      return floatBinop<std::minus>(size, num);
+    case llvm::Instruction::FMul:
+      return floatBinop<std::multiplies>(size, num);
+    case llvm::Instruction::FDiv:
+      return floatBinop<std::divides>(size, num);
+    case llvm::Instruction::ICmp:
+    {
+      const llvm::CmpInst *cmp = (const llvm::CmpInst*)decoded.instruction;
+      size = getValueSize(cmp->getOperand(0)).first;
+      switch (cmp->getPredicate())
+      {
+      case llvm::CmpInst::ICMP_EQ:
+        return intCmp<std::equal_to>(false, size, num);
+      case llvm::CmpInst::ICMP_NE:
+        return intCmp<std::not_equal_to>(false, size, num);
+      case llvm::CmpInst::ICMP_UGT:
+        return intCmp<std::greater>(false, size, num);
+      case llvm::CmpInst::ICMP_UGE:
+        return intCmp<std::greater_equal>(false, size, num);
+      case llvm::CmpInst::ICMP_ULT:
+        return intCmp<std::less>(false, size, num);
+      case llvm::CmpInst::ICMP_ULE:
+        return intCmp<std::less_equal>(false, size, num);
+      case llvm::CmpInst::ICMP_SGT:
+        return intCmp<std::greater>(true, size, num);
+      case llvm::CmpInst::ICMP_SGE:
+        return intCmp<std::greater_equal>(true, size, num);
+      case llvm::CmpInst::ICMP_SLT:
+        return intCmp<std::less>(true, size, num);
+      case llvm::CmpInst::ICMP_SLE:
+        return intCmp<std::less_equal>(true, size, num);
+      default:
+        return NULL;
+      }
+    }
+    case llvm::Instruction::FCmp:
+    {
+      // Only specialize predicates whose NaN behaviour matches C++
+      const llvm::CmpInst *cmp = (const llvm::CmpInst*)decoded.instruction;
+      size = getValueSize(cmp->getOperand(0)).first;
+      switch (cmp->getPredicate())
+      {
+      case llvm::CmpInst::FCMP_OEQ:
+        return floatCmp<std::equal_to>(size, num);
+      case llvm::CmpInst::FCMP_UNE:
+        return floatCmp<std::not_equal_to>(size, num);
+      case llvm::CmpInst::FCMP_OGT:
+        return floatCmp<std::greater>(size, num);
+      case llvm::CmpInst::FCMP_OGE:
+        return floatCmp<std::greater_equal>(size, num);
+      case llvm::CmpInst::FCMP_OLT:
+        return floatCmp<std::less>(size, num);
+      case llvm::CmpInst::FCMP_OLE:
+        return floatCmp<std::less_equal>(size, num);
+      default:
+        return NULL;
+      }
+    }
+    default:
+      return NULL;
+    }
+  }
+};
+
 
 ////////////////////////////////
 // WorkItem::InterpreterCache //
@@ -1596,10 +1812,12 @@ InterpreterCache::InterpreterCache(llvm::Function *kernel)
 {
   // TODO: Determine this number dynamically?
   m_valueIDs.reserve(1024);
+  m_usesWorkGroupSync = false;
 
   // Add global variables to cache
   // TODO: Only add variables that are used?
   const llvm::Module *module = kernel->getParent();
+  m_dataLayout = &module->getDataLayout();
   llvm::Module::const_global_iterator G;
   for (G = module->global_begin(); G != module->global_end(); G++)
   {
@@ -1609,6 +1827,7 @@ InterpreterCache::InterpreterCache(llvm::Function *kernel)
 
   set<llvm::Function*> processed;
   set<llvm::Function*> pending;
+  size_t numInstructions = 0;
 
   pending.insert(kernel);
 
@@ -1631,6 +1850,7 @@ InterpreterCache::InterpreterCache(llvm::Function *kernel)
     for (I = inst_begin(function); I != inst_end(function); I++)
     {
       addValueID(&*I);
+      m_instructionIndices[&*I] = numInstructions++;
 
       // Check for function calls
       if (I->getOpcode() == llvm::Instruction::Call)
@@ -1658,6 +1878,62 @@ InterpreterCache::InterpreterCache(llvm::Function *kernel)
       }
     }
   }
+
+  // Lower each function into a pre-decoded instruction stream, with the
+  // instructions of each basic block stored contiguously
+  m_instructions.resize(numInstructions);
+  for (auto F = processed.begin(); F != processed.end(); F++)
+  {
+    llvm::inst_iterator I;
+    for (I = inst_begin(*F); I != inst_end(*F); I++)
+    {
+      decode(m_instructions[m_instructionIndices.at(&*I)], &*I);
+    }
+  }
+
+  // Assign fixed storage slots to instruction results and to the arguments
+  // of called functions, so that work-item memory use is bounded
+  vector<const llvm::Value*> values(m_valueIDs.size());
+  for (auto V = m_valueIDs.begin(); V != m_valueIDs.end(); V++)
+  {
+    values[V->second] = V->first;
+  }
+
+  m_valueSlots.resize(values.size());
+  m_valueStorageSize = 0;
+  for (unsigned i = 0; i < values.size(); i++)
+  {
+    ValueSlot& slot = m_valueSlots[i];
+    slot.size = slot.num = 0;
+    slot.offset = 0;
+
+    auto arg = llvm::dyn_cast<llvm::Argument>(values[i]);
+    if (!llvm::isa<llvm::Instruction>(values[i]) &&
+        !(arg && arg->getParent() != kernel))
+    {
+      continue;
+    }
+
+    pair<unsigned,unsigned> size = getValueSize(values[i]);
+    size_t bytes = size.first*size.second;
+    if (!bytes)
+    {
+      continue;
+    }
+
+    // Align slot to size of value, up to 16 bytes
+    size_t align = 1;
+    while (align < bytes && align < 16)
+    {
+      align <<= 1;
+    }
+    m_valueStorageSize = (m_valueStorageSize + align - 1) & ~(align - 1);
+
+    slot.size = size.first;
+    slot.num = size.second;
+    slot.offset = m_valueStorageSize;
+    m_valueStorageSize += bytes;
+  }
 }
 
 InterpreterCache::~InterpreterCache()
@@ -1669,11 +1945,10 @@ InterpreterCache::~InterpreterCache()
     delete[] constItr->second.data;
   }
 
-  ConstExprMap::iterator constExprItr;
-  for (constExprItr  = m_constExpressions.begin();
-       constExprItr != m_constExpressions.end(); constExprItr++)
+  for (Instruction *expr : m_constExprInstructions)
   {
-    constExprItr->second->deleteValue();
+    const_cast<llvm::Instruction*>(expr->instruction)->deleteValue();
+    delete expr;
   }
 }
 
@@ -1703,12 +1978,22 @@ void InterpreterCache::addBuiltin(
     overload = "";
   }
 
+  // Check for builtins that synchronize work-items within a work-group
+  if (name == "barrier" || name == "work_group_barrier" ||
+      name == "async_work_group_copy" ||
+      name == "async_work_group_strided_copy" ||
+      name == "wait_group_events")
+  {
+    m_usesWorkGroupSync = true;
+  }
+
   // Find builtin function in map
   BuiltinFunctionMap::iterator bItr = workItemBuiltins.find(name);
   if (bItr != workItemBuiltins.end())
   {
     // Add builtin to cache
-    const InterpreterCache::Builtin builtin = {bItr->second, name, overload};
+    const InterpreterCache::Builtin builtin =
+      {bItr->second, name, overload, getOverloadArgType(overload)};
     m_builtins[function] = builtin;
     return;
   }
@@ -1721,7 +2006,8 @@ void InterpreterCache::addBuiltin(
     if (name.compare(0, pItr->first.length(), pItr->first) == 0)
     {
       // Add builtin to cache
-      const InterpreterCache::Builtin builtin = {pItr->second, name, overload};
+      const InterpreterCache::Builtin builtin =
+        {pItr->second, name, overload, getOverloadArgType(overload)};
       m_builtins[function] = builtin;
       return;
     }
@@ -1731,7 +2017,7 @@ void InterpreterCache::addBuiltin(
   FATAL_ERROR("Undefined external function: %s", name.c_str());
 }
 
-InterpreterCache::Builtin InterpreterCache::getBuiltin(
+const InterpreterCache::Builtin& InterpreterCache::getBuiltin(
   const llvm::Function *function) const
 {
   return m_builtins.at(function);
@@ -1766,7 +2052,7 @@ TypedValue InterpreterCache::getConstant(const llvm::Value *operand) const
   return itr->second;
 }
 
-const llvm::Instruction* InterpreterCache::getConstantExpr(
+const InterpreterCache::Operand& InterpreterCache::getConstantExpr(
   const llvm::Value *expr) const
 {
   ConstExprMap::const_iterator itr = m_constExpressions.find(expr);
@@ -1777,6 +2063,283 @@ const llvm::Instruction* InterpreterCache::getConstantExpr(
   return itr->second;
 }
 
+unsigned InterpreterCache::getNumConstantExprs() const
+{
+  return m_constExprInstructions.size();
+}
+
+void InterpreterCache::decode(Instruction& decoded,
+                              const llvm::Instruction *instruction)
+{
+  decoded.instruction = instruction;
+  decoded.opcode = instruction->getOpcode();
+  decoded.builtin = NULL;
+  decoded.id = hasValue(instruction) ? getValueID(instruction) : 0;
+
+  pair<unsigned,unsigned> resultSize = getValueSize(instruction);
+  decoded.resultSize = resultSize.first;
+  decoded.resultNum = resultSize.second;
+
+  // Resolve instruction handler
+  switch (decoded.opcode)
+  {
+  case llvm::Instruction::Add:
+    decoded.handler = &WorkItem::add;
+    break;
+  case llvm::Instruction::Alloca:
+    decoded.handler = &WorkItem::alloc;
+    break;
+  case llvm::Instruction::And:
+    decoded.handler = &WorkItem::bwand;
+    break;
+  case llvm::Instruction::AShr:
+    decoded.handler = &WorkItem::ashr;
+    break;
+  case llvm::Instruction::BitCast:
+    decoded.handler = &WorkItem::bitcast;
+    break;
+  case llvm::Instruction::Br:
+    decoded.handler = &WorkItem::br;
+    break;
+  case llvm::Instruction::Call:
+    decoded.handler = &WorkItem::call;
+    break;
+  case llvm::Instruction::ExtractElement:
+    decoded.handler = &WorkItem::extractelem;
+    break;
+  case llvm::Instruction::ExtractValue:
+    decoded.handler = &WorkItem::extractval;
+    break;
+  case llvm::Instruction::FAdd:
+    decoded.handler = &WorkItem::fadd;
+    break;
+  case llvm::Instruction::FCmp:
+    decoded.handler = &WorkItem::fcmp;
+    break;
+  case llvm::Instruction::FDiv:
+    decoded.handler = &WorkItem::fdiv;
+    break;
+  case llvm::Instruction::FMul:
+    decoded.handler = &WorkItem::fmul;
+    break;
+#if LLVM_VERSION >= 80
+  case llvm::Instruction::FNeg:
+    decoded.handler = &WorkItem::fneg;
+    break;
+#endif
+  case llvm::Instruction::FPExt:
+    decoded.handler = &WorkItem::fpext;
+    break;
+  case llvm::Instruction::FPToSI:
+    decoded.handler = &WorkItem::fptosi;
+    break;
+  case llvm::Instruction::FPToUI:
+    decoded.handler = &WorkItem::fptoui;
+    break;
+  case llvm::Instruction::FPTrunc:
+    decoded.handler = &WorkItem::fptrunc;
+    break;
+  case llvm::Instruction::FRem:
+    decoded.handler = &WorkItem::frem;
+    break;
+  case llvm::Instruction::FSub:
+    decoded.handler = &WorkItem::fsub;
+    break;
+  case llvm::Instruction::GetElementPtr:
+    decoded.handler = &WorkItem::gep;
+    break;
+  case llvm::Instruction::ICmp:
+    decoded.handler = &WorkItem::icmp;
+    break;
+  case llvm::Instruction::InsertElement:
+    decoded.handler = &WorkItem::insertelem;
+    break;
+  case llvm::Instruction::InsertValue:
+    decoded.handler = &WorkItem::insertval;
+    break;
+  case llvm::Instruction::IntToPtr:
+    decoded.handler = &WorkItem::inttoptr;
+    break;
+  case llvm::Instruction::Load:
+    decoded.handler = &WorkItem::load;
+    break;
+  case llvm::Instruction::LShr:
+    decoded.handler = &WorkItem::lshr;
+    break;
+  case llvm::Instruction::Mul:
+    decoded.handler = &WorkItem::mul;
+    break;
+  case llvm::Instruction::Or:
+    decoded.handler = &WorkItem::bwor;
+    break;
+  case llvm::Instruction::PHI:
+    decoded.handler = &WorkItem::phi;
+    break;
+  case llvm::Instruction::PtrToInt:
+    decoded.handler = &WorkItem::ptrtoint;
+    break;
+  case llvm::Instruction::Ret:
+    decoded.handler = &WorkItem::ret;
+    break;
+  case llvm::Instruction::SDiv:
+    decoded.handler = &WorkItem::sdiv;
+    break;
+  case llvm::Instruction::Select:
+    decoded.handler = &WorkItem::select;
+    break;
+  case llvm::Instruction::SExt:
+    decoded.handler = &WorkItem::sext;
+    break;
+  case llvm::Instruction::Shl:
+    decoded.handler = &WorkItem::shl;
+    break;
+  case llvm::Instruction::ShuffleVector:
+    decoded.handler = &WorkItem::shuffle;
+    break;
+  case llvm::Instruction::SIToFP:
+    decoded.handler = &WorkItem::sitofp;
+    break;
+  case llvm::Instruction::SRem:
+    decoded.handler = &WorkItem::srem;
+    break;
+  case llvm::Instruction::Store:
+    decoded.handler = &WorkItem::store;
+    break;
+  case llvm::Instruction::Sub:
+    decoded.handler = &WorkItem::sub;
+    break;
+  case llvm::Instruction::Switch:
+    decoded.handler = &WorkItem::swtch;
+    break;
+  case llvm::Instruction::Trunc:
+    decoded.handler = &WorkItem::itrunc;
+    break;
+  case llvm::Instruction::UDiv:
+    decoded.handler = &WorkItem::udiv;
+    break;
+  case llvm::Instruction::UIToFP:
+    decoded.handler = &WorkItem::uitofp;
+    break;
+  case llvm::Instruction::URem:
+    decoded.handler = &WorkItem::urem;
+    break;
+  case llvm::Instruction::Unreachable:
+    decoded.handler = &WorkItem::unreachable;
+    break;
+  case llvm::Instruction::Xor:
+    decoded.handler = &WorkItem::bwxor;
+    break;
+  case llvm::Instruction::ZExt:
+    decoded.handler = &WorkItem::zext;
+    break;
+  default:
+    // Only raise an error if the instruction is actually executed
+    decoded.handler = &WorkItem::unsupported;
+    break;
+  }
+
+  // Use a handler specialized for the result type where possible
+  InstructionHandler specialized = WorkItem::SpecializedHandlers::get(decoded);
+  if (specialized)
+  {
+    decoded.handler = specialized;
+  }
+
+  // Decode operands
+  for (llvm::User::const_value_op_iterator O = instruction->value_op_begin();
+       O != instruction->value_op_end(); O++)
+  {
+    decoded.operands.push_back(decodeOperand(*O));
+  }
+
+  // Resolve branch targets
+  if (decoded.opcode == llvm::Instruction::Br)
+  {
+    const llvm::BranchInst *br = (const llvm::BranchInst*)instruction;
+    for (unsigned i = 0; i < br->getNumSuccessors(); i++)
+    {
+      decoded.targets.push_back(getInstruction(&br->getSuccessor(i)->front()));
+    }
+  }
+  else if (decoded.opcode == llvm::Instruction::Switch)
+  {
+    const llvm::SwitchInst *swtch = (const llvm::SwitchInst*)instruction;
+    for (unsigned i = 0; i < swtch->getNumSuccessors(); i++)
+    {
+      decoded.targets.push_back(
+        getInstruction(&swtch->getSuccessor(i)->front()));
+    }
+  }
+  else if (decoded.opcode == llvm::Instruction::Call)
+  {
+    // Resolve entry point and arguments of defined functions
+    const llvm::CallInst *call = (const llvm::CallInst*)instruction;
+    const llvm::Function *callee =
+      (const llvm::Function*)call->getCalledValue()->stripPointerCasts();
+    if (!callee->isDeclaration())
+    {
+      decoded.targets.push_back(getEntryPoint(callee));
+
+      llvm::Function::const_arg_iterator A;
+      for (A = callee->arg_begin(); A != callee->arg_end(); A++)
+      {
+        decoded.args.push_back(getValueID(&*A));
+      }
+    }
+    else
+    {
+      decoded.builtin = &getBuiltin(callee);
+    }
+  }
+}
+
+InterpreterCache::Operand InterpreterCache::decodeOperand(
+  const llvm::Value *operand)
+{
+  Operand decoded;
+  decoded.type = Operand::VALUE;
+  decoded.id = 0;
+  decoded.constant.size = 0;
+  decoded.constant.num = 0;
+  decoded.constant.data = NULL;
+  decoded.expr = NULL;
+  decoded.value = operand;
+
+  unsigned valID = operand->getValueID();
+  if (isCachedConstant(valID))
+  {
+    decoded.type = Operand::CONSTANT;
+    decoded.constant = getConstant(operand);
+  }
+  else if (valID == llvm::Value::ConstantExprVal)
+  {
+    decoded = getConstantExpr(operand);
+  }
+  else
+  {
+    decoded.id = getValueID(operand);
+  }
+
+  return decoded;
+}
+
+const InterpreterCache::Instruction* InterpreterCache::getEntryPoint(
+  const llvm::Function *function) const
+{
+  return getInstruction(&function->front().front());
+}
+
+const InterpreterCache::Instruction* InterpreterCache::getInstruction(
+  const llvm::Instruction *instruction) const
+{
+  InstructionMap::const_iterator itr = m_instructionIndices.find(instruction);
+  if (itr == m_instructionIndices.end())
+  {
+    FATAL_ERROR("Instruction not found in cache");
+  }
+  return &m_instructions[itr->second];
+}
+
 unsigned InterpreterCache::addValueID(const llvm::Value *value)
 {
   ValueMap::iterator itr = m_valueIDs.find(value);
@@ -1804,24 +2367,31 @@ unsigned InterpreterCache::getNumValues() const
   return m_valueIDs.size();
 }
 
+const vector<InterpreterCache::ValueSlot>&
+InterpreterCache::getValueSlots() const
+{
+  return m_valueSlots;
+}
+
+size_t InterpreterCache::getValueStorageSize() const
+{
+  return m_valueStorageSize;
+}
+
 bool InterpreterCache::hasValue(const llvm::Value *value) const
 {
   return m_valueIDs.count(value);
 }
 
+bool InterpreterCache::usesWorkGroupSync() const
+{
+  return m_usesWorkGroupSync;
+}
+
 void InterpreterCache::addOperand(const llvm::Value *operand)
 {
   // Resolve constants
-  if (operand->getValueID() == llvm::Value::UndefValueVal            ||
-      operand->getValueID() == llvm::Value::ConstantAggregateZeroVal ||
-      operand->getValueID() == llvm::Value::ConstantDataArrayVal     ||
-      operand->getValueID() == llvm::Value::ConstantDataVectorVal    ||
-      operand->getValueID() == llvm::Value::ConstantIntVal           ||
-      operand->getValueID() == llvm::Value::ConstantFPVal            ||
-      operand->getValueID() == llvm::Value::ConstantArrayVal         ||
-      operand->getValueID() == llvm::Value::ConstantStructVal        ||
-      operand->getValueID() == llvm::Value::ConstantVectorVal        ||
-      operand->getValueID() == llvm::Value::ConstantPointerNullVal)
+  if (isCachedConstant(operand->getValueID()))
   {
     addConstant(operand);
   }
@@ -1831,12 +2401,60 @@ void InterpreterCache::addOperand(const llvm::Value *operand)
     const llvm::ConstantExpr *expr = (const llvm::ConstantExpr*)operand;
     if (!m_constExpressions.count(expr))
     {
+      // Determine whether the expression depends on any addresses
+      Operand::Type type = Operand::CONSTANT;
       for (auto O = expr->op_begin(); O != expr->op_end(); O++)
       {
         addOperand(*O);
+
+        const llvm::Value *op = O->get();
+        if (auto global = llvm::dyn_cast<llvm::GlobalVariable>(op))
+        {
+          if (global->getType()->getPointerAddressSpace() == AddrSpacePrivate)
+            type = Operand::CONSTANT_EXPR;
+          else if (type == Operand::CONSTANT)
+            type = Operand::GROUP_CONSTANT_EXPR;
+        }
+        else if (op->getValueID() == llvm::Value::ConstantExprVal)
+        {
+          Operand::Type opType = getConstantExpr(op).type;
+          if (opType == Operand::CONSTANT_EXPR)
+            type = Operand::CONSTANT_EXPR;
+          else if (opType == Operand::GROUP_CONSTANT_EXPR &&
+                   type == Operand::CONSTANT)
+            type = Operand::GROUP_CONSTANT_EXPR;
+        }
+        else if (!isCachedConstant(op->getValueID()))
+        {
+          type = Operand::CONSTANT_EXPR;
+        }
       }
-      m_constExpressions[expr] = getConstExprAsInstruction(expr);
-      // TODO: Resolve actual value?
+
+      // Fold expressions with constant inputs once for the whole program
+      if (type == Operand::CONSTANT)
+      {
+        const llvm::Constant *folded =
+          llvm::ConstantFoldConstant(expr, *m_dataLayout);
+        if (folded && isCachedConstant(folded->getValueID()))
+        {
+          addConstant(folded);
+          Operand constant = {
+            Operand::CONSTANT, 0, getConstant(folded), NULL, expr
+          };
+          m_constExpressions[expr] = constant;
+          return;
+        }
+        type = Operand::GROUP_CONSTANT_EXPR;
+      }
+
+      // Otherwise evaluate on first use and cache the result
+      Instruction *decoded = new Instruction;
+      decode(*decoded, getConstExprAsInstruction(expr));
+      decoded->id = m_constExprInstructions.size();
+      m_constExprInstructions.push_back(decoded);
+
+      Operand cached = {type, 0, {0, 0, NULL}, decoded, expr};
+      m_constExpressions[expr] = cached;
     }
   }
   else
@@ -13,6 +13,7 @@ namespace llvm
   class BasicBlock;
   class CallInst;
   class ConstExpr;
+  class DataLayout;
   class DILocalVariable;
   class Function;
   class Module;
@@ -55,40 +56,108 @@ namespace oclgrind
     {
       BuiltinFunction function;
       std::string name, overload;
+      char argType;              // Type of first argument from overload
+    };
+
+    struct Instruction;
+    typedef void (WorkItem::*InstructionHandler)(const Instruction*,
+                                                 TypedValue&);
+
+    // Operand of a pre-decoded instruction
+    // Constant expressions that cannot be folded are evaluated on first use
+    // and cached per work-item, or per work-group if they do not depend on
+    // the address of a private variable
+    struct Operand
+    {
+      enum Type {VALUE, CONSTANT, CONSTANT_EXPR, GROUP_CONSTANT_EXPR};
+      Type type;
+      unsigned id;               // Value ID (VALUE)
+      TypedValue constant;       // Constant data (CONSTANT)
+      const Instruction *expr;   // Decoded expression (*CONSTANT_EXPR)
+      const llvm::Value *value;
+    };
+
+    // Pre-decoded instruction, lowered once per kernel
+    struct Instruction
+    {
+      InstructionHandler handler;
+      const llvm::Instruction *instruction;
+      unsigned opcode;
+      unsigned id;               // Value ID of result
+      unsigned resultSize;
+      unsigned resultNum;
+      std::vector<Operand> operands;
+
+      // Successor blocks for terminators, entry block for calls
+      std::vector<const Instruction*> targets;
+
+      // Value IDs of callee arguments for calls to defined functions
+      std::vector<unsigned> args;
+
+      // Resolved builtin for calls to declared functions
+      const Builtin *builtin;
+    };
+
+    // Fixed storage assigned to an SSA value, reused each time it is defined
+    struct ValueSlot
+    {
+      unsigned size;
+      unsigned num;
+      size_t offset;
     };
 
     InterpreterCache(llvm::Function *kernel);
     ~InterpreterCache();
 
     void addBuiltin(const llvm::Function *function);
-    Builtin getBuiltin(const llvm::Function *function) const;
+    const Builtin& getBuiltin(const llvm::Function *function) const;
 
     void addConstant(const llvm::Value *constant);
     TypedValue getConstant(const llvm::Value *operand) const;
-    const llvm::Instruction* getConstantExpr(const llvm::Value *expr) const;
+    const Operand& getConstantExpr(const llvm::Value *expr) const;
+    unsigned getNumConstantExprs() const;
+
+    const Instruction* getEntryPoint(const llvm::Function *function) const;
+    const Instruction* getInstruction(
+      const llvm::Instruction *instruction) const;
 
     unsigned addValueID(const llvm::Value *value);
     unsigned getValueID(const llvm::Value *value) const;
     unsigned getNumValues() const;
+    const std::vector<ValueSlot>& getValueSlots() const;
+    size_t getValueStorageSize() const;
     bool hasValue(const llvm::Value *value) const;
+    bool usesWorkGroupSync() const;
 
   private:
     typedef std::unordered_map<const llvm::Value*, unsigned> ValueMap;
     typedef std::unordered_map<const llvm::Function*, Builtin> BuiltinMap;
     typedef std::unordered_map<const llvm::Value*, TypedValue> ConstantMap;
-    typedef std::unordered_map<const llvm::Value*, llvm::Instruction*>
-      ConstExprMap;
+    typedef std::unordered_map<const llvm::Value*, Operand> ConstExprMap;
+    typedef std::unordered_map<const llvm::Value*, unsigned> InstructionMap;
 
     BuiltinMap m_builtins;
     ConstantMap m_constants;
     ConstExprMap m_constExpressions;
+    std::vector<Instruction*> m_constExprInstructions;
     ValueMap m_valueIDs;
+    std::vector<ValueSlot> m_valueSlots;
+    size_t m_valueStorageSize;
+    const llvm::DataLayout *m_dataLayout;
+    bool m_usesWorkGroupSync;
+
+    // Decoded instruction stream for all functions reachable from kernel
+    std::vector<Instruction> m_instructions;
+    InstructionMap m_instructionIndices;
 
     void addOperand(const llvm::Value *value);
+    void decode(Instruction& decoded, const llvm::Instruction *instruction);
+    Operand decodeOperand(const llvm::Value *operand);
   };
 
   class WorkItem
   {
+    friend class InterpreterCache;
     friend class WorkItemBuiltins;
 
   public:
@@ -100,15 +169,18 @@ namespace oclgrind
     virtual ~WorkItem();
 
     void clearBarrier();
-    void dispatch(const llvm::Instruction *instruction, TypedValue& result);
-    void execute(const llvm::Instruction *instruction);
+    void dispatch(const InterpreterCache::Instruction *instruction,
+                  TypedValue& result);
+    void execute(const InterpreterCache::Instruction *instruction);
     const std::stack<const llvm::Instruction*>& getCallStack() const;
     const llvm::BasicBlock* getCurrentBlock() const;
+    const InterpreterCache::Instruction* getCurrentDecodedInstruction() const;
     const llvm::Instruction* getCurrentInstruction() const;
     Size3 getGlobalID() const;
     size_t getGlobalIndex() const;
     Size3 getLocalID() const;
     TypedValue getOperand(const llvm::Value *operand) const;
+    void* getPluginData(unsigned index) const;
     const llvm::BasicBlock* getPreviousBlock() const;
     Memory* getPrivateMemory() const;
     State getState() const;
@@ -116,12 +188,15 @@ namespace oclgrind
     const WorkGroup* getWorkGroup() const;
     void printExpression(std::string expr) const;
     bool printValue(const llvm::Value *value) const;
+    void reset(Size3 lid);
+    void setPluginData(unsigned index, void *data) const;
     State step();
 
     // SPIR instructions
   private:
 #define INSTRUCTION(name) \
-  void name(const llvm::Instruction *instruction, TypedValue& result)
+  void name(const InterpreterCache::Instruction *instruction, \
+            TypedValue& result)
     INSTRUCTION(add);
     INSTRUCTION(alloc);
     INSTRUCTION(ashr);
@@ -170,8 +245,17 @@ namespace oclgrind
     INSTRUCTION(swtch);
     INSTRUCTION(udiv);
     INSTRUCTION(uitofp);
+    INSTRUCTION(unreachable);
+    INSTRUCTION(unsupported);
     INSTRUCTION(urem);
     INSTRUCTION(zext);
+
+    // Type-specialized instruction handlers, selected when decoding
+    template<typename T, unsigned N, template<typename> class Op>
+    INSTRUCTION(binop);
+    template<typename T, unsigned N, template<typename> class Op>
+    INSTRUCTION(cmpop);
+    struct SpecializedHandlers;
 #undef INSTRUCTION
 
   private:
@@ -182,10 +266,13 @@ namespace oclgrind
     size_t m_globalIndex;
     Size3 m_globalID;
     Size3 m_localID;
-    TypedValueMap m_phiTemps;
+    std::vector<std::pair<unsigned,TypedValue>> m_phiTemps;
+    mutable std::vector<TypedValue> m_constExprValues;
     VariableMap m_variables;
     const Context *m_context;
     const KernelInvocation *m_kernelInvocation;
+    bool m_notifyInstructions;
+    mutable PluginData m_pluginData;
     Memory *m_privateMemory;
     WorkGroup *m_workGroup;
     mutable MemoryPool m_pool;
@@ -197,7 +284,15 @@ namespace oclgrind
     Memory* getMemory(unsigned int addrSpace) const;
 
     // Store for instruction results and other operand values
+    // Instruction results and function arguments point into fixed storage
+    // slots, while temporaries only live until the next instruction
     std::vector<TypedValue> m_values;
+    unsigned char *m_valueStorage;
+    mutable MemoryPool m_tempPool;
+    TypedValue evaluateConstantExpr(
+      const InterpreterCache::Operand& operand) const;
+    TypedValue getCallArgument(unsigned index) const;
+    TypedValue getOperand(const InterpreterCache::Operand& operand) const;
     TypedValue getValue(const llvm::Value *key) const;
     bool hasValue(const llvm::Value *key) const;
     void setValue(const llvm::Value *key, TypedValue value);
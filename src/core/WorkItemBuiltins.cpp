@@ -47,10 +47,10 @@ namespace oclgrind
                    const string& fnName, const string& overload,       \
                    TypedValue& result, void *)
 #define ARG(i) (callInst->getArgOperand(i))
-#define UARGV(i,v) workItem->getOperand(ARG(i)).getUInt(v)
-#define SARGV(i,v) workItem->getOperand(ARG(i)).getSInt(v)
-#define FARGV(i,v) workItem->getOperand(ARG(i)).getFloat(v)
-#define PARGV(i,v) workItem->getOperand(ARG(i)).getPointer(v)
+#define UARGV(i,v) workItem->getCallArgument(i).getUInt(v)
+#define SARGV(i,v) workItem->getCallArgument(i).getSInt(v)
+#define FARGV(i,v) workItem->getCallArgument(i).getFloat(v)
+#define PARGV(i,v) workItem->getCallArgument(i).getPointer(v)
 #define UARG(i) UARGV(i, 0)
 #define SARG(i) SARGV(i, 0)
 #define FARG(i) FARGV(i, 0)
@@ -159,17 +159,10 @@ namespace oclgrind
       }
     }
 
-    // Extract the (first) argument type from an overload string
-    static char getOverloadArgType(const string& overload)
+    // Get the (first) argument type, parsed from the overload when decoding
+    static char getOverloadArgType(const WorkItem *workItem)
     {
-      char type = overload[0];
-      if (type == 'D')
-      {
-        char *typestr;
-        strtol(overload.c_str() + 2, &typestr, 10);
-        type = typestr[1];
-      }
-      return type;
+      return workItem->getCurrentDecodedInstruction()->builtin->argType;
     }
 
 
@@ -377,7 +370,7 @@ namespace oclgrind
 
     DEFINE_BUILTIN(clamp)
     {
-      switch (getOverloadArgType(overload))
+      switch (getOverloadArgType(workItem))
       {
         case 'f':
         case 'd':
@@ -410,13 +403,13 @@ namespace oclgrind
           break;
         default:
           FATAL_ERROR("Unsupported argument type: %c",
-                      getOverloadArgType(overload));
+                      getOverloadArgType(workItem));
       }
     }
 
     DEFINE_BUILTIN(max)
     {
-      switch (getOverloadArgType(overload))
+      switch (getOverloadArgType(workItem))
       {
         case 'f':
         case 'd':
@@ -448,13 +441,13 @@ namespace oclgrind
           break;
         default:
           FATAL_ERROR("Unsupported argument type: %c",
-                      getOverloadArgType(overload));
+                      getOverloadArgType(workItem));
       }
     }
 
     DEFINE_BUILTIN(min)
     {
-      switch (getOverloadArgType(overload))
+      switch (getOverloadArgType(workItem))
       {
         case 'f':
         case 'd':
@@ -486,7 +479,7 @@ namespace oclgrind
           break;
         default:
           FATAL_ERROR("Unsupported argument type: %c",
-                      getOverloadArgType(overload));
+                      getOverloadArgType(workItem));
       }
     }
 
@@ -1012,7 +1005,7 @@ namespace oclgrind
                         + channel*channelSize;
 
       // Load channel data
-      unsigned char *data = workItem->m_pool.alloc(channelSize);
+      unsigned char *data = workItem->m_tempPool.alloc(channelSize);
       if (!workItem->getMemory(AddrSpaceGlobal)->load(data, address,
                                                        channelSize))
       {
@@ -1086,7 +1079,7 @@ namespace oclgrind
                         + channel*channelSize;
 
       // Load channel data
-      unsigned char *data = workItem->m_pool.alloc(channelSize);
+      unsigned char *data = workItem->m_tempPool.alloc(channelSize);
       if (!workItem->getMemory(AddrSpaceGlobal)->load(data, address,
                                                        channelSize))
       {
@@ -1151,7 +1144,7 @@ namespace oclgrind
                         + channel*channelSize;
 
       // Load channel data
-      unsigned char *data = workItem->m_pool.alloc(channelSize);
+      unsigned char *data = workItem->m_tempPool.alloc(channelSize);
       if (!workItem->getMemory(AddrSpaceGlobal)->load(data, address,
                                                        channelSize))
       {
@@ -1536,7 +1529,7 @@ namespace oclgrind
 
       // Generate channel values
       Memory *memory = workItem->getMemory(AddrSpaceGlobal);
-      unsigned char *data = workItem->m_pool.alloc(channelSize*numChannels);
+      unsigned char *data = workItem->m_tempPool.alloc(channelSize*numChannels);
       for (unsigned i = 0; i < numChannels; i++)
       {
         switch (image->format.image_channel_data_type)
@@ -1638,7 +1631,7 @@ namespace oclgrind
 
       // Generate channel values
       Memory *memory = workItem->getMemory(AddrSpaceGlobal);
-      unsigned char *data = workItem->m_pool.alloc(channelSize*numChannels);
+      unsigned char *data = workItem->m_tempPool.alloc(channelSize*numChannels);
       for (unsigned i = 0; i < numChannels; i++)
       {
         switch (image->format.image_channel_data_type)
@@ -1728,7 +1721,7 @@ namespace oclgrind
 
       // Generate channel values
       Memory *memory = workItem->getMemory(AddrSpaceGlobal);
-      unsigned char *data = workItem->m_pool.alloc(channelSize*numChannels);
+      unsigned char *data = workItem->m_tempPool.alloc(channelSize*numChannels);
       for (unsigned i = 0; i < numChannels; i++)
       {
         switch (image->format.image_channel_data_type)
@@ -1761,7 +1754,7 @@ namespace oclgrind
     {
       for (unsigned i = 0; i < result.num; i++)
       {
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
           case 't':
@@ -1777,7 +1770,7 @@ namespace oclgrind
             break;
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -1786,7 +1779,7 @@ namespace oclgrind
     {
       for (unsigned i = 0; i < result.num; i++)
       {
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
           case 't':
@@ -1810,7 +1803,7 @@ namespace oclgrind
           }
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -1821,7 +1814,7 @@ namespace oclgrind
       {
         uint64_t uresult = UARGV(0,i) + UARGV(1,i);
         int64_t  sresult = SARGV(0,i) + SARGV(1,i);
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
             uresult = _min_<uint64_t>(uresult, UINT8_MAX);
@@ -1861,7 +1854,7 @@ namespace oclgrind
             break;
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -1887,7 +1880,7 @@ namespace oclgrind
     {
       for (unsigned i = 0; i < result.num; i++)
       {
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
           case 't':
@@ -1913,7 +1906,7 @@ namespace oclgrind
           }
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -1981,7 +1974,7 @@ namespace oclgrind
     {
       for (unsigned i = 0; i < result.num; i++)
       {
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
           case 't':
@@ -2005,7 +1998,7 @@ namespace oclgrind
           }
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -2016,7 +2009,7 @@ namespace oclgrind
       {
         uint64_t uresult = UARGV(0,i)*UARGV(1,i) + UARGV(2,i);
         int64_t  sresult = SARGV(0,i)*SARGV(1,i) + SARGV(2,i);
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
             uresult = _min_<uint64_t>(uresult, UINT8_MAX);
@@ -2071,7 +2064,7 @@ namespace oclgrind
             break;
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -2085,7 +2078,7 @@ namespace oclgrind
     {
       for (unsigned i = 0; i < result.num; i++)
       {
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
           case 't':
@@ -2107,7 +2100,7 @@ namespace oclgrind
           }
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -2127,7 +2120,7 @@ namespace oclgrind
     {
       for (unsigned i = 0; i < result.num; i++)
       {
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
           case 't':
@@ -2153,7 +2146,7 @@ namespace oclgrind
           }
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -2176,7 +2169,7 @@ namespace oclgrind
       {
         uint64_t uresult = UARGV(0,i) - UARGV(1,i);
         int64_t  sresult = SARGV(0,i) - SARGV(1,i);
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
             uresult = uresult > UINT8_MAX ? 0 : uresult;
@@ -2216,7 +2209,7 @@ namespace oclgrind
             break;
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -2260,8 +2253,8 @@ namespace oclgrind
 
     DEFINE_BUILTIN(fmax_builtin)
     {
-      TypedValue a = workItem->getOperand(ARG(0));
-      TypedValue b = workItem->getOperand(ARG(1));
+      TypedValue a = workItem->getCallArgument(0);
+      TypedValue b = workItem->getCallArgument(1);
       for (unsigned i = 0; i < result.num; i++)
       {
         double _b = b.num > 1 ? b.getFloat(i) : b.getFloat();
@@ -2274,8 +2267,8 @@ namespace oclgrind
 
     DEFINE_BUILTIN(fmin_builtin)
     {
-      TypedValue a = workItem->getOperand(ARG(0));
-      TypedValue b = workItem->getOperand(ARG(1));
+      TypedValue a = workItem->getCallArgument(0);
+      TypedValue b = workItem->getCallArgument(1);
       for (unsigned i = 0; i < result.num; i++)
       {
         double _b = b.num > 1 ? b.getFloat(i) : b.getFloat();
@@ -2695,7 +2688,7 @@ namespace oclgrind
 
     DEFINE_BUILTIN(bitselect)
     {
-      switch (getOverloadArgType(overload))
+      switch (getOverloadArgType(workItem))
       {
         case 'f':
         case 'd':
@@ -2713,13 +2706,13 @@ namespace oclgrind
           break;
         default:
           FATAL_ERROR("Unsupported argument type: %c",
-                      getOverloadArgType(overload));
+                      getOverloadArgType(workItem));
       }
     }
 
     DEFINE_BUILTIN(select_builtin)
     {
-      char type = getOverloadArgType(overload);
+      char type = getOverloadArgType(workItem);
       for (unsigned i = 0; i < result.num; i++)
       {
         int64_t c = SARGV(2, i);
@@ -2742,7 +2735,7 @@ namespace oclgrind
             break;
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
     }
@@ -2815,7 +2808,7 @@ namespace oclgrind
         address = base + offset*sizeof(cl_half)*result.num;
       }
       size_t size = sizeof(cl_half)*result.num;
-      uint16_t *halfData = (uint16_t*)workItem->m_pool.alloc(2*result.num);
+      uint16_t *halfData = (uint16_t*)workItem->m_tempPool.alloc(2*result.num);
       workItem->getMemory(addressSpace)->load((unsigned char*)halfData,
                                               address, size);
 
@@ -2846,7 +2839,7 @@ namespace oclgrind
       TypedValue op = workItem->getOperand(value);
       unsigned char *data = op.data;
       size = op.num*sizeof(cl_half);
-      uint16_t *halfData = (uint16_t*)workItem->m_pool.alloc(2*op.num);
+      uint16_t *halfData = (uint16_t*)workItem->m_tempPool.alloc(2*op.num);
 
       // Parse rounding mode (RTE is the default)
       HalfRoundMode rmode = Half_RTE;
@@ -2979,7 +2972,7 @@ namespace oclgrind
 
     DEFINE_BUILTIN(astype)
     {
-      TypedValue src = workItem->getOperand(ARG(0));
+      TypedValue src = workItem->getCallArgument(0);
       memcpy(result.data, src.data, src.size*src.num);
     }
 
@@ -3020,7 +3013,7 @@ namespace oclgrind
 
       for (unsigned i = 0; i < result.num; i++)
       {
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
           case 't':
@@ -3046,7 +3039,7 @@ namespace oclgrind
             break;
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
       }
       fesetround(origRnd);
@@ -3062,7 +3055,7 @@ namespace oclgrind
         rmode = Half_RTN;
       else if (fnName.find("_rtp") != std::string::npos)
         rmode = Half_RTP;
-      const char srcType = getOverloadArgType(overload);
+      const char srcType = getOverloadArgType(workItem);
       for (unsigned i = 0; i < result.num; i++)
       {
         switch (srcType)
@@ -3085,7 +3078,7 @@ namespace oclgrind
             break;
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
         result.setUInt(floatToHalf(f, rmode), i);
       }
@@ -3121,7 +3114,7 @@ namespace oclgrind
       for (unsigned i = 0; i < result.num; i++)
       {
         uint64_t r;
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
           case 't':
@@ -3167,7 +3160,7 @@ namespace oclgrind
             break;
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
 
         result.setUInt(r, i);
@@ -3209,7 +3202,7 @@ namespace oclgrind
       for (unsigned i = 0; i < result.num; i++)
       {
         int64_t r;
-        switch (getOverloadArgType(overload))
+        switch (getOverloadArgType(workItem))
         {
           case 'h':
           case 't':
@@ -3245,7 +3238,7 @@ namespace oclgrind
             break;
           default:
             FATAL_ERROR("Unsupported argument type: %c",
-                        getOverloadArgType(overload));
+                        getOverloadArgType(workItem));
         }
 
         result.setSInt(r, i);
@@ -3255,9 +3248,13 @@ namespace oclgrind
 
     DEFINE_BUILTIN(printf_builtin)
     {
+      // Output was already produced when the work-group first ran
+      if (workItem->m_kernelInvocation->isReplaying())
+        return;
+
       lock_guard<mutex> lck(printfMutex);
 
-      size_t formatPtr = workItem->getOperand(ARG(0)).getPointer();
+      size_t formatPtr = workItem->getCallArgument(0).getPointer();
       Memory *memory = workItem->getMemory(AddrSpaceGlobal);
 
       int arg = 1;
@@ -3455,7 +3452,7 @@ namespace oclgrind
       unsigned destAddrSpace = memcpyInst->getDestAddressSpace();
       unsigned srcAddrSpace = memcpyInst->getSourceAddressSpace();
 
-      unsigned char *buffer = workItem->m_pool.alloc(size);
+      unsigned char *buffer = workItem->m_tempPool.alloc(size);
       workItem->getMemory(srcAddrSpace)->load(buffer, src, size);
       workItem->getMemory(destAddrSpace)->store(buffer, dest, size);
     }
@@ -3467,7 +3464,7 @@ namespace oclgrind
       size_t size = workItem->getOperand(memsetInst->getLength()).getUInt();
       unsigned addressSpace = memsetInst->getDestAddressSpace();
 
-      unsigned char *buffer = workItem->m_pool.alloc(size);
+      unsigned char *buffer = workItem->m_tempPool.alloc(size);
       unsigned char value = UARG(1);
       memset(buffer, value, size);
       workItem->getMemory(addressSpace)->store(buffer, dest, size);
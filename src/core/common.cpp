@@ -8,6 +8,7 @@
 
 #include "config.h"
 #include "common.h"
+#include "half.h"
 
 #if defined(_WIN32) && !defined(__MINGW32__)
 #include <time.h>
@@ -99,6 +100,8 @@ namespace oclgrind
   {
     switch (size)
     {
+    case 2:
+      return halfToFloat(((uint16_t*)data)[index]);
     case 4:
       return ((float*)data)[index];
     case 8:
@@ -155,6 +158,9 @@ namespace oclgrind
   {
     switch (size)
     {
+    case 2:
+      ((uint16_t*)data)[index] = doubleToHalf(value, Half_RTE);
+      break;
     case 4:
       ((float*)data)[index] = value;
       break;
@@ -893,14 +899,39 @@ namespace oclgrind
     return runtime_error::what();
   }
 
+  void PluginData::clear()
+  {
+    m_slots.assign(m_slots.size(), NULL);
+  }
+
+  void* PluginData::get(unsigned index) const
+  {
+    return index < m_slots.size() ? m_slots[index] : NULL;
+  }
+
+  void PluginData::resize(unsigned numSlots)
+  {
+    if (numSlots > m_slots.size())
+      m_slots.resize(numSlots, NULL);
+  }
+
+  void PluginData::set(unsigned index, void *data)
+  {
+    if (index >= m_slots.size())
+      m_slots.resize(index+1, NULL);
+    m_slots[index] = data;
+  }
+
   MemoryPool::MemoryPool(size_t blockSize) : m_blockSize(blockSize)
   {
     // Force first allocation to create new block
     m_offset = m_blockSize;
+    m_numBlocksUsed = 0;
   }
 
   MemoryPool::~MemoryPool()
   {
+    reset();
     for (auto itr = m_blocks.begin(); itr != m_blocks.end(); itr++)
     {
       delete[] *itr;
@@ -917,7 +948,7 @@ namespace oclgrind
     {
       // Oversized buffers allocated separately from main pool
       unsigned char *buffer = new unsigned char[size];
-      m_blocks.push_back(buffer);
+      m_oversized.push_back(buffer);
       return buffer;
     }
 
@@ -940,15 +971,30 @@ namespace oclgrind
     // Check if enough space in current block
     if (m_offset + size > m_blockSize)
     {
-      // Allocate new block
-      m_blocks.push_front(new unsigned char[m_blockSize]);
+      // Move to next block, allocating a new one if none are free
+      if (m_numBlocksUsed == m_blocks.size())
+        m_blocks.push_back(new unsigned char[m_blockSize]);
+      m_numBlocksUsed++;
       m_offset = 0;
     }
-    uint8_t *buffer = m_blocks.front() + m_offset;
+    uint8_t *buffer = m_blocks[m_numBlocksUsed-1] + m_offset;
     m_offset += size;
     return buffer;
   }
 
+  void MemoryPool::reset()
+  {
+    // Release oversized buffers and reuse existing blocks
+    for (auto itr = m_oversized.begin(); itr != m_oversized.end(); itr++)
+    {
+      delete[] *itr;
+    }
+    m_oversized.clear();
+
+    m_numBlocksUsed = 0;
+    m_offset = m_blockSize;
+  }
+
   TypedValue MemoryPool::clone(const TypedValue& source)
   {
     TypedValue dest;
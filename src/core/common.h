@@ -231,6 +231,20 @@ namespace oclgrind
       throw FatalError(msg, __FILE__, __LINE__);         \
     }
 
+  // Data attached to an entity by plugins, indexed by Plugin::getIndex()
+  // Setting data is not synchronized, so plugins should attach data to
+  // shared entities before other threads can access them
+  class PluginData
+  {
+  public:
+    void clear();
+    void* get(unsigned index) const;
+    void resize(unsigned numSlots);
+    void set(unsigned index, void *data);
+  private:
+    std::vector<void*> m_slots;
+  };
+
   class MemoryPool
   {
   public:
@@ -238,10 +252,13 @@ namespace oclgrind
     ~MemoryPool();
     uint8_t* alloc(size_t size);
     TypedValue clone(const TypedValue& source);
+    void reset();
   private:
     size_t m_blockSize;
     size_t m_offset;
-    std::list<uint8_t*> m_blocks;
+    size_t m_numBlocksUsed;
+    std::vector<uint8_t*> m_blocks;
+    std::list<uint8_t*> m_oversized;
   };
 
   // Pool allocator class for STL containers
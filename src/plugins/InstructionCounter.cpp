@@ -17,8 +17,10 @@
 
 #include "InstructionCounter.h"
 
+#include "core/Context.h"
 #include "core/Kernel.h"
 #include "core/KernelInvocation.h"
+#include "core/Memory.h"
 
 using namespace oclgrind;
 using namespace std;
@@ -83,9 +85,20 @@ string InstructionCounter::getOpcodeName(unsigned opcode) const
   return llvm::Instruction::getOpcodeName(opcode);
 }
 
-void InstructionCounter::instructionExecuted(
-  const WorkItem *workItem, const llvm::Instruction *instruction,
-  const TypedValue& result)
+void InstructionCounter::asyncEvents(const AsyncEvent *events, size_t num)
+{
+  // Count each batch separately, as analysis threads may be given events
+  // from any work-group
+  resetState();
+  for (size_t i = 0; i < num; i++)
+  {
+    if (events[i].event == EventInstructionExecuted)
+      countInstruction(events[i].instruction);
+  }
+  mergeState();
+}
+
+void InstructionCounter::countInstruction(const llvm::Instruction *instruction)
 {
   unsigned opcode = instruction->getOpcode();
 
@@ -130,6 +143,13 @@ void InstructionCounter::instructionExecuted(
   (*m_state.instCounts)[opcode]++;
 }
 
+void InstructionCounter::instructionExecuted(
+  const WorkItem *workItem, const llvm::Instruction *instruction,
+  const TypedValue& result)
+{
+  countInstruction(instruction);
+}
+
 void InstructionCounter::kernelBegin(const KernelInvocation *kernelInvocation)
 {
   m_instructionCounts.clear();
@@ -181,30 +201,27 @@ void InstructionCounter::kernelEnd(const KernelInvocation *kernelInvocation)
 
   cout << endl;
 
-  // Restore locale
-  cout.imbue(previousLocale);
-}
-
-void InstructionCounter::workGroupBegin(const WorkGroup *workGroup)
-{
-  // Create worker state if haven't already
-  if (!m_state.instCounts)
-  {
-    m_state.instCounts = new vector<size_t>;
-    m_state.memopBytes = new vector<size_t>;
-    m_state.functions = new vector<const llvm::Function*>;
-  }
+  // Output scheduling overhead
+  KernelInvocation::SchedulerStats stats =
+    kernelInvocation->getSchedulerStats();
+  cout << "Scheduled " << dec << stats.numWorkGroups << " work-groups in "
+       << stats.numChunks << " chunks (" << stats.numSteals << " steals), "
+       << "scheduling overhead " << fixed << setprecision(3)
+       << stats.overhead*1000 << " ms" << defaultfloat << endl;
 
-  m_state.instCounts->clear();
-  m_state.instCounts->resize(COUNTED_CALL_BASE);
+  // Output global memory usage
+  const Memory *globalMemory = m_context->getGlobalMemory();
+  cout << "Global memory: " << globalMemory->getResidentSize()
+       << " bytes resident of " << globalMemory->getTotalAllocated()
+       << " bytes allocated" << endl;
 
-  m_state.memopBytes->clear();
-  m_state.memopBytes->resize(16);
+  cout << endl;
 
-  m_state.functions->clear();
+  // Restore locale
+  cout.imbue(previousLocale);
 }
 
-void InstructionCounter::workGroupComplete(const WorkGroup *workGroup)
+void InstructionCounter::mergeState()
 {
   lock_guard<mutex> lock(m_mtx);
 
@@ -242,3 +259,52 @@ void InstructionCounter::workGroupComplete(const WorkGroup *workGroup)
   for (unsigned i = 0; i < m_state.memopBytes->size(); i++)
     m_memopBytes[i] += m_state.memopBytes->at(i);
 }
+
+bool InstructionCounter::needsEvent(Event event) const
+{
+  switch (event)
+  {
+  case EventInstructionExecuted:
+  case EventKernelBegin:
+  case EventKernelEnd:
+  case EventWorkGroupBegin:
+  case EventWorkGroupComplete:
+    return true;
+  default:
+    return false;
+  }
+}
+
+void InstructionCounter::resetState()
+{
+  // Create worker state if haven't already
+  if (!m_state.instCounts)
+  {
+    m_state.instCounts = new vector<size_t>;
+    m_state.memopBytes = new vector<size_t>;
+    m_state.functions = new vector<const llvm::Function*>;
+  }
+
+  m_state.instCounts->clear();
+  m_state.instCounts->resize(COUNTED_CALL_BASE);
+
+  m_state.memopBytes->clear();
+  m_state.memopBytes->resize(16);
+
+  m_state.functions->clear();
+}
+
+bool InstructionCounter::supportsAsyncEvents() const
+{
+  return true;
+}
+
+void InstructionCounter::workGroupBegin(const WorkGroup *workGroup)
+{
+  resetState();
+}
+
+void InstructionCounter::workGroupComplete(const WorkGroup *workGroup)
+{
+  mergeState();
+}
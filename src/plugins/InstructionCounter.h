@@ -22,6 +22,7 @@ namespace oclgrind
   public:
     InstructionCounter(const Context *context) : Plugin(context){};
 
+    virtual void asyncEvents(const AsyncEvent *events, size_t num) override;
     virtual void instructionExecuted(const WorkItem *workItem,
                                      const llvm::Instruction *instruction,
                                      const TypedValue& result) override;
@@ -29,6 +30,8 @@ namespace oclgrind
     virtual void kernelEnd(const KernelInvocation *kernelInvocation) override;
     virtual void workGroupBegin(const WorkGroup *workGroup) override;
     virtual void workGroupComplete(const WorkGroup *workGroup) override;
+    virtual bool needsEvent(Event event) const override;
+    virtual bool supportsAsyncEvents() const override;
 
   private:
     std::vector<size_t> m_instructionCounts;
@@ -45,6 +48,9 @@ namespace oclgrind
 
     std::mutex m_mtx;
 
+    void countInstruction(const llvm::Instruction *instruction);
     std::string getOpcodeName(unsigned opcode) const;
+    void mergeState();
+    void resetState();
   };
 }
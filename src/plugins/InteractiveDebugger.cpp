@@ -218,6 +218,20 @@ void InteractiveDebugger::log(MessageType type, const char *message)
     m_forceBreak = true;
 }
 
+bool InteractiveDebugger::needsEvent(Event event) const
+{
+  switch (event)
+  {
+  case EventInstructionExecuted:
+  case EventKernelBegin:
+  case EventKernelEnd:
+  case EventLog:
+    return true;
+  default:
+    return false;
+  }
+}
+
 ///////////////////////////
 //// Utility Functions ////
 ///////////////////////////
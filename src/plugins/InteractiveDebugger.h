@@ -25,6 +25,7 @@ namespace oclgrind
     virtual void log(MessageType type, const char *message) override;
 
     virtual bool isThreadSafe() const override;
+    virtual bool needsEvent(Event event) const override;
 
   private:
 
@@ -69,3 +69,8 @@ void Logger::log(MessageType type, const char *message)
 
   *m_log << endl << message << endl;
 }
+
+bool Logger::needsEvent(Event event) const
+{
+  return event == EventLog;
+}
@@ -17,6 +17,7 @@ namespace oclgrind
     virtual ~Logger();
 
     virtual void log(MessageType type, const char *message) override;
+    virtual bool needsEvent(Event event) const override;
 
   private:
     std::ostream *m_log;
@@ -25,36 +25,6 @@ MemCheck::MemCheck(const Context *context)
 {
 }
 
-void MemCheck::instructionExecuted(const WorkItem *workItem,
-                                   const llvm::Instruction *instruction,
-                                   const TypedValue& result)
-{
-  // Check static array bounds if load or store is executed
-  const llvm::Value *PtrOp = nullptr;
-
-  if (auto LI = llvm::dyn_cast<llvm::LoadInst>(instruction))
-  {
-    PtrOp = LI->getPointerOperand();
-  }
-  else if (auto SI = llvm::dyn_cast<llvm::StoreInst>(instruction))
-  {
-    PtrOp = SI->getPointerOperand();
-  }
-  else
-  {
-    return;
-  }
-
-  // Walk up chain of GEP instructions leading to this access
-  while (auto GEPI =
-           llvm::dyn_cast<llvm::GetElementPtrInst>(PtrOp->stripPointerCasts()))
-  {
-    checkArrayAccess(workItem, GEPI);
-
-    PtrOp = GEPI->getPointerOperand();
-  }
-}
-
 void MemCheck::memoryAtomicLoad(const Memory *memory,
                                 const WorkItem *workItem,
                                 AtomicOp op, size_t address, size_t size)
@@ -73,6 +43,7 @@ void MemCheck::memoryLoad(const Memory *memory, const WorkItem *workItem,
                           size_t address, size_t size)
 {
   checkLoad(memory, address, size);
+  checkArrayAccesses(workItem);
 }
 
 void MemCheck::memoryLoad(const Memory *memory, const WorkGroup *workGroup,
@@ -97,6 +68,7 @@ void MemCheck::memoryStore(const Memory *memory, const WorkItem *workItem,
                            const uint8_t *storeData)
 {
   checkStore(memory, address, size);
+  checkArrayAccesses(workItem);
 }
 
 void MemCheck::memoryStore(const Memory *memory, const WorkGroup *workGroup,
@@ -121,6 +93,23 @@ void MemCheck::memoryUnmap(const Memory *memory, size_t address,
   }
 }
 
+bool MemCheck::needsEvent(Event event) const
+{
+  // Static array bounds are checked when loads and stores access memory
+  switch (event)
+  {
+  case EventMemoryAtomicLoad:
+  case EventMemoryAtomicStore:
+  case EventMemoryLoad:
+  case EventMemoryMap:
+  case EventMemoryStore:
+  case EventMemoryUnmap:
+    return true;
+  default:
+    return false;
+  }
+}
+
 void MemCheck::checkArrayAccess(const WorkItem *workItem,
                                 const llvm::GetElementPtrInst *GEPI) const
 {
@@ -162,6 +151,35 @@ void MemCheck::checkArrayAccess(const WorkItem *workItem,
   }
 }
 
+void MemCheck::checkArrayAccesses(const WorkItem *workItem) const
+{
+  // Check static array bounds if a load or store instruction is executing
+  const llvm::Instruction *instruction = workItem->getCurrentInstruction();
+  const llvm::Value *PtrOp = nullptr;
+
+  if (auto LI = llvm::dyn_cast<llvm::LoadInst>(instruction))
+  {
+    PtrOp = LI->getPointerOperand();
+  }
+  else if (auto SI = llvm::dyn_cast<llvm::StoreInst>(instruction))
+  {
+    PtrOp = SI->getPointerOperand();
+  }
+  else
+  {
+    return;
+  }
+
+  // Walk up chain of GEP instructions leading to this access
+  while (auto GEPI =
+           llvm::dyn_cast<llvm::GetElementPtrInst>(PtrOp->stripPointerCasts()))
+  {
+    checkArrayAccess(workItem, GEPI);
+
+    PtrOp = GEPI->getPointerOperand();
+  }
+}
+
 void MemCheck::checkLoad(const Memory *memory,
                          size_t address, size_t size) const
 {
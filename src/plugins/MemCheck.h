@@ -20,9 +20,6 @@ namespace oclgrind
   public:
     MemCheck(const Context *context);
 
-    virtual void instructionExecuted(const WorkItem *workItem,
-                                     const llvm::Instruction *instruction,
-                                     const TypedValue& result) override;
     virtual void memoryAtomicLoad(const Memory *memory,
                                   const WorkItem *workItem,
                                   AtomicOp op,
@@ -46,10 +43,12 @@ namespace oclgrind
                              const uint8_t *storeData) override;
     virtual void memoryUnmap(const Memory *memory, size_t address,
                              const void *ptr) override;
+    virtual bool needsEvent(Event event) const override;
 
   private:
     void checkArrayAccess(const WorkItem *workItem,
                           const llvm::GetElementPtrInst *GEPI) const;
+    void checkArrayAccesses(const WorkItem *workItem) const;
     void checkLoad(const Memory *memory, size_t address, size_t size) const;
     void checkStore(const Memory *memory, size_t address, size_t size) const;
     void logInvalidAccess(bool read, unsigned addrSpace,
@@ -9,29 +9,55 @@
 #include "core/common.h"
 
 #include "core/Context.h"
+#include "core/Kernel.h"
 #include "core/KernelInvocation.h"
 #include "core/Memory.h"
+#include "core/Program.h"
 #include "core/WorkGroup.h"
 #include "core/WorkItem.h"
 
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Module.h"
+
 #include "RaceDetector.h"
 
 using namespace oclgrind;
 using namespace std;
 
-THREAD_LOCAL RaceDetector::WorkerState RaceDetector::m_state = {NULL};
+#define STATE(workgroup) \
+  (*(WorkGroupState*)(workgroup)->getPluginData(getIndex()))
+
+// Global memory is shadowed in pages, with a record for each aligned word
+// that is split into records for each byte if it is partially accessed
+#define SHADOW_PAGE_SIZE 4096 // Must be power of two
+#define SHADOW_WORD_SIZE 4
+#define SHADOW_PAGE_WORDS (SHADOW_PAGE_SIZE/SHADOW_WORD_SIZE)
+
+struct RaceDetector::ShadowPage
+{
+  ShadowRecord words[SHADOW_PAGE_WORDS];
+
+  // Index (plus one) of the byte records of each split word, which are
+  // discarded when the page is first accessed in a new epoch
+  uint16_t split[SHADOW_PAGE_WORDS];
+  std::vector<ShadowRecord> bytes;
+  uint16_t epoch;
+};
 
-#define STATE(workgroup) (m_state.groups->at(workgroup))
+// Maximum number of programs with cached instruction numbering
+#define MAX_INSTRUCTION_TABLES 16
 
 // Use a bank of mutexes to reduce unnecessary synchronisation
 #define NUM_GLOBAL_MUTEXES 4096 // Must be power of two
-#define GLOBAL_MUTEX(buffer,offset) \
-  m_globalMutexes[buffer][offset & (NUM_GLOBAL_MUTEXES-1)]
+#define GLOBAL_MUTEX(state,offset) \
+  (state)->mutexes[(offset/SHADOW_PAGE_SIZE) & (NUM_GLOBAL_MUTEXES-1)]
 
 RaceDetector::RaceDetector(const Context *context)
  : Plugin(context)
 {
   m_kernelInvocation = NULL;
+  m_epoch = 1;
+  m_instructionTable = NULL;
 
   m_allowUniformWrites = !checkEnv("OCLGRIND_UNIFORM_WRITES");
 }
@@ -39,6 +65,34 @@ RaceDetector::RaceDetector(const Context *context)
 void RaceDetector::kernelBegin(const KernelInvocation *kernelInvocation)
 {
   m_kernelInvocation = kernelInvocation;
+
+  // Number the instructions of each program once for shadow accesses,
+  // reserving zero for accesses without an instruction
+  const Kernel *kernel = kernelInvocation->getKernel();
+  unsigned long uid = kernel->getProgram()->getUID();
+  auto table = m_instructionTables.find(uid);
+  if (table == m_instructionTables.end())
+  {
+    if (m_instructionTables.size() >= MAX_INSTRUCTION_TABLES)
+      m_instructionTables.clear();
+    table = m_instructionTables.emplace(uid, InstructionTable()).first;
+
+    InstructionTable& instructions = table->second;
+    instructions.instructions.assign(1, NULL);
+    const llvm::Module *module = kernel->getFunction()->getParent();
+    for (const llvm::Function& function : *module)
+    {
+      for (const llvm::BasicBlock& block : function)
+      {
+        for (const llvm::Instruction& instruction : block)
+        {
+          instructions.ids[&instruction] = instructions.instructions.size();
+          instructions.instructions.push_back(&instruction);
+        }
+      }
+    }
+  }
+  m_instructionTable = &table->second;
 }
 
 void RaceDetector::kernelEnd(const KernelInvocation *kernelInvocation)
@@ -48,12 +102,13 @@ void RaceDetector::kernelEnd(const KernelInvocation *kernelInvocation)
     logRace(race);
   kernelRaces.clear();
 
-  // Clear all global memory accesses
-  for (auto &buffer : m_globalAccesses)
+  // Clear all global memory accesses by starting a new epoch, releasing
+  // the shadows only when the epoch wraps around
+  if (++m_epoch == 0)
   {
-    size_t sz = buffer.second.size();
-    buffer.second.clear();
-    buffer.second.resize(sz);
+    for (auto &buffer : m_globalBuffers)
+      releaseShadow(buffer.second);
+    m_epoch = 1;
   }
 
   m_kernelInvocation = NULL;
@@ -66,8 +121,12 @@ void RaceDetector::memoryAllocated(const Memory *memory, size_t address,
   size_t buffer = memory->extractBuffer(address);
   if (memory->getAddressSpace() == AddrSpaceGlobal)
   {
-    m_globalAccesses[buffer].resize(size);
-    m_globalMutexes[buffer] = new mutex[NUM_GLOBAL_MUTEXES];
+    GlobalBufferState *state = new GlobalBufferState;
+    state->pages.resize((size + SHADOW_PAGE_SIZE - 1) / SHADOW_PAGE_SIZE);
+    state->mutexes = new mutex[NUM_GLOBAL_MUTEXES];
+    if (memory->getBuffer(address))
+      memory->getBuffer(address)->pluginData.set(getIndex(), state);
+    m_globalBuffers[buffer] = state;
   }
 }
 
@@ -93,10 +152,14 @@ void RaceDetector::memoryDeallocated(const Memory *memory, size_t address)
   size_t buffer = memory->extractBuffer(address);
   if (memory->getAddressSpace() == AddrSpaceGlobal)
   {
-    m_globalAccesses.erase(buffer);
-
-    delete[] m_globalMutexes.at(buffer);
-    m_globalMutexes.erase(buffer);
+    GlobalBufferState *state = m_globalBuffers.at(buffer);
+    if (memory->getBuffer(address))
+      memory->getBuffer(address)->pluginData.set(getIndex(), NULL);
+    m_globalBuffers.erase(buffer);
+
+    releaseShadow(state);
+    delete[] state->mutexes;
+    delete state;
   }
 }
 
@@ -145,20 +208,16 @@ void RaceDetector::workGroupBarrier(const WorkGroup *workGroup, uint32_t flags)
 
 void RaceDetector::workGroupBegin(const WorkGroup *workGroup)
 {
-  // Create worker state if haven't already
-  if (!m_state.groups)
-  {
-    m_state.groups = new unordered_map<const WorkGroup*,WorkGroupState>;
-  }
-
   // Initialize work-group state
-  WorkGroupState& state = (*m_state.groups)[workGroup];
+  WorkGroupState *groupState = new WorkGroupState;
+  workGroup->setPluginData(getIndex(), groupState);
+
+  WorkGroupState& state = *groupState;
   Size3 wgsize = workGroup->getGroupSize();
   state.numWorkItems = wgsize.x*wgsize.y*wgsize.z;
 
   // Re-use pool allocator for all access maps
-  AccessMap tmp(0, AccessMap::hasher(), AccessMap::key_equal(),
-                state.wgGlobal.get_allocator());
+  AccessMap tmp(AccessMap::key_compare(), state.wgGlobal.get_allocator());
   state.wiGlobal.resize(state.numWorkItems+1, tmp);
   state.wiLocal.resize(state.numWorkItems+1, tmp);
 }
@@ -171,40 +230,80 @@ void RaceDetector::workGroupComplete(const WorkGroup *workGroup)
   syncWorkItems(m_context->getGlobalMemory(), state, state.wiGlobal);
 
   // Merge global accesses across kernel invocation
+  const Memory *globalMemory = m_context->getGlobalMemory();
   size_t group = workGroup->getGroupIndex();
-  for (auto &record : state.wgGlobal)
+  for (auto &entry : state.wgGlobal)
   {
-    size_t address = record.first;
-    size_t buffer = m_context->getGlobalMemory()->extractBuffer(address);
-    size_t offset = m_context->getGlobalMemory()->extractOffset(address);
+    size_t address = entry.first;
+    const AccessRange& range = entry.second;
+    const uint8_t *storeData =
+      range.storeData.empty() ? NULL : range.storeData.data();
 
-    lock_guard<mutex> lock(GLOBAL_MUTEX(buffer, offset));
+    size_t offset = globalMemory->extractOffset(address);
+    GlobalBufferState *buffer = (GlobalBufferState*)
+      globalMemory->getBuffer(address)->pluginData.get(getIndex());
 
-    AccessRecord& a = record.second;
-    AccessRecord& b = m_globalAccesses.at(buffer)[offset];
+    while (address < range.end)
+    {
+      // Lock each page once, and merge it one word at a time
+      size_t pageEnd = min(range.end,
+                           address + SHADOW_PAGE_SIZE -
+                           offset % SHADOW_PAGE_SIZE);
 
-    // Check for races with previous accesses
-    if (check(a.load,  b.store) && getAccessWorkGroup(b.store) != group)
-      insertKernelRace({AddrSpaceGlobal, address, a.load, b.store});
-    if (check(a.store, b.load) && getAccessWorkGroup(b.load) != group)
-      insertKernelRace({AddrSpaceGlobal, address, a.store, b.load});
-    if (check(a.store, b.store) && getAccessWorkGroup(b.store) != group)
-      insertKernelRace({AddrSpaceGlobal, address, a.store, b.store});
+      lock_guard<mutex> lock(GLOBAL_MUTEX(buffer, offset));
 
-    // Insert accesses
-    if (a.load.isSet())
-      insert(b, a.load);
-    if (a.store.isSet())
-      insert(b, a.store);
+      ShadowPage *&page = buffer->pages[offset / SHADOW_PAGE_SIZE];
+      if (!page)
+      {
+        page = new ShadowPage();
+        page->epoch = m_epoch;
+      }
+      else if (page->epoch != m_epoch)
+      {
+        memset(page->split, 0, sizeof(page->split));
+        page->bytes.clear();
+        page->epoch = m_epoch;
+      }
+
+      while (address < pageEnd)
+      {
+        size_t size = min(pageEnd - address,
+                          SHADOW_WORD_SIZE - offset % SHADOW_WORD_SIZE);
+        mergeShadow(page, address, offset, range.record, storeData, size,
+                    group);
+
+        address += size;
+        offset += size;
+        if (storeData)
+          storeData += size;
+      }
+    }
   }
   state.wgGlobal.clear();
 
   // Clean-up work-group state
-  m_state.groups->erase(workGroup);
-  if (m_state.groups->empty())
+  workGroup->setPluginData(getIndex(), NULL);
+  delete &state;
+}
+
+bool RaceDetector::needsEvent(Event event) const
+{
+  switch (event)
   {
-    delete m_state.groups;
-    m_state.groups = NULL;
+  case EventKernelBegin:
+  case EventKernelEnd:
+  case EventMemoryAllocated:
+  case EventMemoryAtomicLoad:
+  case EventMemoryAtomicStore:
+  case EventMemoryDeallocated:
+  case EventMemoryLoad:
+  case EventMemoryStore:
+  case EventWorkGroupBarrier:
+  case EventWorkGroupBegin:
+  case EventWorkGroupComplete:
+    return true;
+  default:
+    return false;
   }
 }
 
@@ -238,6 +337,82 @@ bool RaceDetector::check(const MemoryAccess& a,
   return false;
 }
 
+bool RaceDetector::check(const MemoryAccess& a, const uint8_t *aData,
+                         const MemoryAccess& b, const uint8_t *bData,
+                         size_t size, size_t& offset) const
+{
+  // Check the whole range at once, unless the race depends on store data
+  MemoryAccess x = a, y = b;
+  x.setStoreData(0);
+  y.setStoreData(0);
+  if (check(x, y))
+  {
+    offset = 0;
+    return true;
+  }
+
+  y.setStoreData(1);
+  if (!check(x, y))
+    return false;
+
+  // Uniform writes only race where their data differs
+  for (offset = 0; offset < size; offset++)
+  {
+    if (aData[offset] != bData[offset])
+      return true;
+  }
+  return false;
+}
+
+void RaceDetector::checkRanges(RaceList& races, unsigned addrSpace,
+                               size_t aBegin, const AccessRange& a,
+                               size_t bBegin, const AccessRange& b) const
+{
+  // Only check where the ranges overlap
+  size_t begin = max(aBegin, bBegin);
+  size_t size = min(a.end, b.end) - begin;
+  const uint8_t *aData = a.storeData.empty() ? NULL :
+    a.storeData.data() + (begin - aBegin);
+  const uint8_t *bData = b.storeData.empty() ? NULL :
+    b.storeData.data() + (begin - bBegin);
+
+  const AccessRecord& x = a.record;
+  const AccessRecord& y = b.record;
+  size_t offset;
+  if (check(x.load,  aData, y.store, bData, size, offset))
+    insertRace(races, {addrSpace, begin+offset, x.load, y.store});
+  if (check(x.store, aData, y.load,  bData, size, offset))
+    insertRace(races, {addrSpace, begin+offset, x.store, y.load});
+  if (check(x.store, aData, y.store, bData, size, offset))
+    insertRace(races, {addrSpace, begin+offset, x.store, y.store});
+}
+
+RaceDetector::ShadowAccess RaceDetector::compress(const MemoryAccess& access,
+                                                  uint32_t storeData) const
+{
+  assert(access.getEntity() < ((uint64_t)1 << 40));
+
+  ShadowAccess shadow;
+  shadow.entity = access.getEntity();
+  auto itr = m_instructionTable->ids.find(access.getInstruction());
+  shadow.instruction = (itr != m_instructionTable->ids.end()) ? itr->second : 0;
+  shadow.storeData = storeData;
+  shadow.info = access.getInfo();
+  shadow.epoch = m_epoch;
+  return shadow;
+}
+
+RaceDetector::MemoryAccess RaceDetector::expand(const ShadowAccess& access,
+                                                unsigned byte) const
+{
+  if (access.epoch != m_epoch)
+    return MemoryAccess();
+
+  return MemoryAccess(access.entity,
+                      m_instructionTable->instructions[access.instruction],
+                      access.info, access.storeData >> 8*byte);
+}
+
 size_t RaceDetector::getAccessWorkGroup(const MemoryAccess& access) const
 {
   if (access.isWorkItem())
@@ -249,19 +424,73 @@ size_t RaceDetector::getAccessWorkGroup(const MemoryAccess& access) const
     return access.getEntity();
 }
 
-void RaceDetector::insert(AccessRecord& record,
+bool RaceDetector::insert(AccessRecord& record,
                           const MemoryAccess& access) const
 {
   if (access.isLoad())
   {
     if (!record.load.isSet() || record.load.isAtomic())
+    {
       record.load = access;
+      return true;
+    }
   }
   else if (access.isStore())
   {
     if (!record.store.isSet() || record.store.isAtomic())
+    {
       record.store = access;
+      return true;
+    }
+  }
+  return false;
+}
+
+void RaceDetector::insert(AccessMap& accesses, size_t address, size_t size,
+                          const AccessRecord& record,
+                          const uint8_t *storeData) const
+{
+  size_t end = address + size;
+
+  // Split existing ranges at the boundaries of the new range
+  splitRange(accesses, address);
+  splitRange(accesses, end);
+
+  auto itr = accesses.lower_bound(address);
+  size_t next = address;
+  while (next < end)
+  {
+    if (itr == accesses.end() || itr->first > next)
+    {
+      // Fill gap between existing ranges
+      AccessRange range;
+      range.end = (itr == accesses.end()) ? end : min(end, itr->first);
+      range.record = record;
+      if (record.store.isSet())
+      {
+        range.storeData.assign(storeData + (next - address),
+                               storeData + (range.end - address));
+      }
+      itr = accesses.emplace_hint(itr, next, std::move(range));
+    }
+    else
+    {
+      // Insert into existing range
+      AccessRange& range = itr->second;
+      if (record.load.isSet())
+        insert(range.record, record.load);
+      if (record.store.isSet() && insert(range.record, record.store))
+      {
+        range.storeData.assign(storeData + (next - address),
+                               storeData + (range.end - address));
+      }
+    }
+
+    next = itr->second.end;
+    itr++;
   }
+
+  mergeRanges(accesses, address, end);
 }
 
 void RaceDetector::insertKernelRace(const Race& race)
@@ -294,6 +523,18 @@ void RaceDetector::insertRace(RaceList& races, const Race& race) const
   races.push_back(race);
 }
 
+void RaceDetector::insertShadow(ShadowAccess& shadow,
+                                const MemoryAccess& access,
+                                uint32_t storeData) const
+{
+  if (!access.isSet())
+    return;
+
+  MemoryAccess current = expand(shadow, 0);
+  if (!current.isSet() || current.isAtomic())
+    shadow = compress(access, storeData);
+}
+
 void RaceDetector::logRace(const Race& race) const
 {
   const char *raceType;
@@ -347,6 +588,112 @@ void RaceDetector::logRace(const Race& race) const
   msg.send();
 }
 
+void RaceDetector::mergeRanges(AccessMap& accesses,
+                               size_t begin, size_t end) const
+{
+  // Merge adjacent ranges with the same accesses, including any range that
+  // ends where the inserted range begins
+  auto itr = accesses.lower_bound(begin);
+  if (itr != accesses.begin())
+    itr--;
+  while (itr != accesses.end())
+  {
+    auto next = std::next(itr);
+    if (next == accesses.end() || next->first > end)
+      break;
+
+    AccessRange& a = itr->second;
+    AccessRange& b = next->second;
+    if (a.end == next->first &&
+        a.record.load == b.record.load && a.record.store == b.record.store)
+    {
+      a.end = b.end;
+      a.storeData.append(b.storeData.data(),
+                         b.storeData.data() + b.storeData.size());
+      accesses.erase(next);
+    }
+    else
+    {
+      itr = next;
+    }
+  }
+}
+
+void RaceDetector::mergeShadow(ShadowPage *page, size_t address,
+                               size_t offset, const AccessRecord& record,
+                               const uint8_t *storeData, unsigned size,
+                               size_t group)
+{
+  unsigned w = (offset & (SHADOW_PAGE_SIZE-1)) / SHADOW_WORD_SIZE;
+  unsigned first = offset % SHADOW_WORD_SIZE;
+
+  // Split word into byte records if only part of it is accessed
+  if (size < SHADOW_WORD_SIZE && !page->split[w])
+  {
+    const ShadowRecord& word = page->words[w];
+    page->split[w] = page->bytes.size()/SHADOW_WORD_SIZE + 1;
+    for (unsigned i = 0; i < SHADOW_WORD_SIZE; i++)
+    {
+      ShadowRecord byte = word;
+      byte.load.storeData = (word.load.storeData >> 8*i) & 0xFF;
+      byte.store.storeData = (word.store.storeData >> 8*i) & 0xFF;
+      page->bytes.push_back(byte);
+    }
+  }
+
+  for (unsigned i = 0; i < size; i++)
+  {
+    MemoryAccess store = record.store;
+    if (storeData)
+      store.setStoreData(storeData[i]);
+
+    ShadowRecord *shadow;
+    unsigned byte;
+    if (page->split[w])
+    {
+      shadow = &page->bytes[(page->split[w]-1)*SHADOW_WORD_SIZE + first + i];
+      byte = 0;
+    }
+    else
+    {
+      shadow = &page->words[w];
+      byte = i;
+    }
+
+    // Check for races with previous accesses
+    MemoryAccess prevLoad = expand(shadow->load, byte);
+    MemoryAccess prevStore = expand(shadow->store, byte);
+    if (check(record.load, prevStore) &&
+        getAccessWorkGroup(prevStore) != group)
+      insertKernelRace({AddrSpaceGlobal, address+i, record.load, prevStore});
+    if (check(store, prevLoad) && getAccessWorkGroup(prevLoad) != group)
+      insertKernelRace({AddrSpaceGlobal, address+i, store, prevLoad});
+    if (check(store, prevStore) && getAccessWorkGroup(prevStore) != group)
+      insertKernelRace({AddrSpaceGlobal, address+i, store, prevStore});
+
+    // Insert accesses
+    if (page->split[w])
+    {
+      insertShadow(shadow->load, record.load, 0);
+      if (record.store.isSet())
+        insertShadow(shadow->store, record.store, storeData[i]);
+    }
+  }
+
+  // Insert accesses for whole word once all bytes have been checked
+  if (!page->split[w])
+  {
+    insertShadow(page->words[w].load, record.load, 0);
+    if (record.store.isSet())
+    {
+      uint32_t data = 0;
+      for (unsigned i = 0; i < SHADOW_WORD_SIZE; i++)
+        data |= (uint32_t)storeData[i] << 8*i;
+      insertShadow(page->words[w].store, record.store, data);
+    }
+  }
+}
+
 void RaceDetector::registerAccess(const Memory *memory,
                                   const WorkGroup *workGroup,
                                   const WorkItem *workItem,
@@ -379,50 +726,81 @@ void RaceDetector::registerAccess(const Memory *memory,
     STATE(workGroup).wiGlobal[index] :
     STATE(workGroup).wiLocal[index];
 
-  for (size_t i = 0; i < size; i++)
+  AccessRecord record;
+  if (storeData)
+    record.store = access;
+  else
+    record.load = access;
+  insert(accesses, address, size, record, storeData);
+}
+
+void RaceDetector::releaseShadow(GlobalBufferState *state) const
+{
+  for (ShadowPage *&page : state->pages)
   {
-    if (storeData)
-      access.setStoreData(storeData[i]);
+    delete page;
+    page = NULL;
+  }
+}
+
+void RaceDetector::splitRange(AccessMap& accesses, size_t address) const
+{
+  // Find range that contains address, unless it starts there
+  auto itr = accesses.lower_bound(address);
+  if (itr != accesses.end() && itr->first == address)
+    return;
+  if (itr == accesses.begin())
+    return;
+  itr--;
 
-    insert(accesses[address+i], access);
+  AccessRange& range = itr->second;
+  if (range.end <= address)
+    return;
+
+  AccessRange tail;
+  tail.end = range.end;
+  tail.record = range.record;
+  if (!range.storeData.empty())
+  {
+    size_t split = address - itr->first;
+    const uint8_t *data = range.storeData.data();
+    tail.storeData.assign(data + split, data + range.storeData.size());
+    range.storeData.truncate(split);
   }
+  range.end = address;
+  accesses.emplace_hint(std::next(itr), address, std::move(tail));
 }
 
 void RaceDetector::syncWorkItems(const Memory *memory,
                                  WorkGroupState& state,
                                  vector<AccessMap>& accesses)
 {
-  AccessMap wgAccesses(0, AccessMap::hasher(), AccessMap::key_equal(),
+  AccessMap wgAccesses(AccessMap::key_compare(),
                        state.wgGlobal.get_allocator());
+  unsigned addrSpace = memory->getAddressSpace();
 
   for (size_t i = 0; i < state.numWorkItems + 1; i++)
   {
     RaceList races;
-    for (auto &record : accesses[i])
+    for (auto &entry : accesses[i])
     {
-      size_t address = record.first;
-
-      AccessRecord& a = record.second;
-      AccessRecord& b = wgAccesses[address];
-
-      if (check(a.load,  b.store))
-        insertRace(races, {memory->getAddressSpace(),address,a.load,b.store});
-      if (check(a.store, b.load))
-        insertRace(races, {memory->getAddressSpace(),address,a.store,b.load});
-      if (check(a.store, b.store))
-        insertRace(races, {memory->getAddressSpace(),address,a.store,b.store});
-
-      if (a.load.isSet())
-      {
-        insert(b, a.load);
-        if (memory->getAddressSpace() == AddrSpaceGlobal)
-          insert(state.wgGlobal[address], a.load);
-      }
-      if (a.store.isSet())
+      size_t address = entry.first;
+      const AccessRange& a = entry.second;
+
+      // Check for races with each overlapping range
+      auto itr = wgAccesses.upper_bound(address);
+      if (itr != wgAccesses.begin() && std::prev(itr)->second.end > address)
+        itr--;
+      for (; itr != wgAccesses.end() && itr->first < a.end; itr++)
+        checkRanges(races, addrSpace, address, a, itr->first, itr->second);
+
+      const uint8_t *storeData =
+        a.storeData.empty() ? NULL : a.storeData.data();
+      insert(wgAccesses, address, a.end - address, a.record, storeData);
+      if (addrSpace == AddrSpaceGlobal)
       {
-        insert(b, a.store);
-        if (memory->getAddressSpace() == AddrSpaceGlobal)
-          insert(state.wgGlobal[address], a.store);
+        insert(state.wgGlobal, address, a.end - address, a.record,
+               storeData);
       }
     }
 
@@ -463,6 +841,16 @@ RaceDetector::MemoryAccess::MemoryAccess(const WorkGroup *workGroup,
   }
 }
 
+RaceDetector::MemoryAccess::MemoryAccess(size_t entity,
+                                         const llvm::Instruction *instruction,
+                                         uint8_t info, uint8_t storeData)
+{
+  this->entity = entity;
+  this->instruction = instruction;
+  this->info = info;
+  this->storeData = storeData;
+}
+
 void RaceDetector::MemoryAccess::clear()
 {
   this->info = 0;
@@ -509,6 +897,11 @@ const llvm::Instruction* RaceDetector::MemoryAccess::getInstruction() const
   return this->instruction;
 }
 
+uint8_t RaceDetector::MemoryAccess::getInfo() const
+{
+  return this->info;
+}
+
 uint8_t RaceDetector::MemoryAccess::getStoreData() const
 {
   return this->storeData;
@@ -522,7 +915,77 @@ void RaceDetector::MemoryAccess::setStoreData(uint8_t data)
 bool RaceDetector::MemoryAccess::operator==(
   const RaceDetector::MemoryAccess& other) const
 {
+  // Unset accesses are equal regardless of their other fields
+  if (!isSet() || !other.isSet())
+    return this->info == other.info;
+
   return this->entity == other.entity &&
          this->instruction == other.instruction &&
          this->info == other.info;
 }
+
+RaceDetector::StoreData::StoreData()
+{
+  m_size = 0;
+}
+
+void RaceDetector::StoreData::append(const uint8_t *begin, const uint8_t *end)
+{
+  size_t size = m_size + (end - begin);
+  if (size <= STORE_DATA_INLINE)
+  {
+    memcpy(m_inline + m_size, begin, end - begin);
+  }
+  else
+  {
+    // Move data to the heap once it no longer fits inline
+    if (m_size <= STORE_DATA_INLINE)
+      m_heap.assign(m_inline, m_inline + m_size);
+    m_heap.insert(m_heap.end(), begin, end);
+  }
+  m_size = size;
+}
+
+void RaceDetector::StoreData::assign(const uint8_t *begin, const uint8_t *end)
+{
+  m_size = end - begin;
+  if (m_size <= STORE_DATA_INLINE)
+  {
+    memcpy(m_inline, begin, m_size);
+    m_heap.clear();
+  }
+  else
+  {
+    m_heap.assign(begin, end);
+  }
+}
+
+const uint8_t* RaceDetector::StoreData::data() const
+{
+  return m_size <= STORE_DATA_INLINE ? m_inline : m_heap.data();
+}
+
+bool RaceDetector::StoreData::empty() const
+{
+  return m_size == 0;
+}
+
+size_t RaceDetector::StoreData::size() const
+{
+  return m_size;
+}
+
+void RaceDetector::StoreData::truncate(size_t size)
+{
+  assert(size <= m_size);
+  if (m_size > STORE_DATA_INLINE && size <= STORE_DATA_INLINE)
+  {
+    memcpy(m_inline, m_heap.data(), size);
+    m_heap.clear();
+  }
+  else if (size > STORE_DATA_INLINE)
+  {
+    m_heap.resize(size);
+  }
+  m_size = size;
+}
@@ -46,6 +46,7 @@ namespace oclgrind
                                   uint32_t flags) override;
     virtual void workGroupBegin(const WorkGroup *workGroup) override;
     virtual void workGroupComplete(const WorkGroup *workGroup) override;
+    virtual bool needsEvent(Event event) const override;
 
   private:
     struct MemoryAccess
@@ -75,12 +76,16 @@ namespace oclgrind
       size_t getEntity() const;
       const llvm::Instruction* getInstruction() const;
 
+      uint8_t getInfo() const;
+
       uint8_t getStoreData() const;
       void    setStoreData(uint8_t);
 
       MemoryAccess();
       MemoryAccess(const WorkGroup *workGroup, const WorkItem *workItem,
                    bool store, bool atomic);
+      MemoryAccess(size_t entity, const llvm::Instruction *instruction,
+                   uint8_t info, uint8_t storeData);
 
       bool operator==(const MemoryAccess& other) const;
     };
@@ -90,15 +95,77 @@ namespace oclgrind
       MemoryAccess store;
     };
     typedef std::vector<MemoryAccess> AccessList;
-    typedef std::unordered_map<
-      size_t,AccessRecord,
-      std::hash<size_t>,
-      std::equal_to<size_t>,
-      PoolAllocator<std::pair<const size_t,AccessRecord>,8192>
+
+    // Store data for each byte of a range, held inline for ranges of up
+    // to STORE_DATA_INLINE bytes so that scalar accesses do not allocate
+    class StoreData
+    {
+    public:
+      static const size_t STORE_DATA_INLINE = 8;
+
+      StoreData();
+
+      void append(const uint8_t *begin, const uint8_t *end);
+      void assign(const uint8_t *begin, const uint8_t *end);
+      const uint8_t* data() const;
+      bool empty() const;
+      void truncate(size_t size);
+      size_t size() const;
+
+    private:
+      size_t m_size;
+      uint8_t m_inline[STORE_DATA_INLINE];
+      std::vector<uint8_t> m_heap;
+    };
+
+    // Accesses that are the same for a range of addresses, apart from the
+    // store data for each byte
+    struct AccessRange
+    {
+      size_t end;
+      AccessRecord record;
+      StoreData storeData; // Empty unless record has a store
+    };
+
+    // Non-overlapping ranges of accesses, keyed by their first address
+    typedef std::map<
+      size_t,AccessRange,
+      std::less<size_t>,
+      PoolAllocator<std::pair<const size_t,AccessRange>,8192>
       > AccessMap;
 
-    std::unordered_map<size_t,std::vector<AccessRecord>> m_globalAccesses;
-    std::map< size_t,std::mutex* > m_globalMutexes;
+    // Compact record of a global memory access, which identifies the
+    // instruction by its index in the program's InstructionTable and can
+    // hold the store data for a whole word
+    // Records from before the current epoch are treated as unset
+    // The entity (a global work-item or work-group index) is limited to 40
+    // bits so that the record still fits in 16 bytes
+    struct ShadowAccess
+    {
+      uint64_t entity : 40;
+      uint64_t info : 8;
+      uint64_t epoch : 16;
+      uint32_t instruction;
+      uint32_t storeData;
+    };
+    struct ShadowRecord
+    {
+      ShadowAccess load;
+      ShadowAccess store;
+    };
+
+    // Shadow of a page of a global memory buffer, allocated when the page
+    // is first accessed
+    struct ShadowPage;
+
+    // State attached to each global memory buffer and work-group through
+    // their plugin data slots
+    struct GlobalBufferState
+    {
+      std::vector<ShadowPage*> pages;
+      std::mutex *mutexes;
+    };
+    std::unordered_map<size_t,GlobalBufferState*> m_globalBuffers;
 
     struct WorkGroupState
     {
@@ -107,11 +174,6 @@ namespace oclgrind
       std::vector<AccessMap> wiGlobal;
       AccessMap wgGlobal;
     };
-    struct WorkerState
-    {
-      std::unordered_map<const WorkGroup*,WorkGroupState> *groups;
-    };
-    static THREAD_LOCAL WorkerState m_state;
 
     struct Race
     {
@@ -124,16 +186,49 @@ namespace oclgrind
     bool m_allowUniformWrites;
     const KernelInvocation *m_kernelInvocation;
 
+    // Incremented for each kernel, so that global memory shadows do not
+    // have to be cleared between kernels
+    uint16_t m_epoch;
+
+    // Instructions of a program, indexed by shadow accesses, and cached by
+    // program UID so that they are only numbered once
+    struct InstructionTable
+    {
+      std::vector<const llvm::Instruction*> instructions;
+      std::unordered_map<const llvm::Instruction*,uint32_t> ids;
+    };
+    std::unordered_map<unsigned long,InstructionTable> m_instructionTables;
+    const InstructionTable *m_instructionTable;
+
     std::mutex kernelRacesMutex;
     RaceList kernelRaces;
 
     size_t getAccessWorkGroup(const MemoryAccess& access) const;
 
     bool check(const MemoryAccess& a, const MemoryAccess& b) const;
-    void insert(AccessRecord& record, const MemoryAccess& access) const;
+    bool check(const MemoryAccess& a, const uint8_t *aData,
+               const MemoryAccess& b, const uint8_t *bData,
+               size_t size, size_t& offset) const;
+    void checkRanges(RaceList& races, unsigned addrSpace,
+                     size_t aBegin, const AccessRange& a,
+                     size_t bBegin, const AccessRange& b) const;
+    ShadowAccess compress(const MemoryAccess& access,
+                          uint32_t storeData) const;
+    MemoryAccess expand(const ShadowAccess& access, unsigned byte) const;
+    bool insert(AccessRecord& record, const MemoryAccess& access) const;
+    void insert(AccessMap& accesses, size_t address, size_t size,
+                const AccessRecord& record, const uint8_t *storeData) const;
     void insertKernelRace(const Race& race);
     void insertRace(RaceList& races, const Race& race) const;
+    void insertShadow(ShadowAccess& shadow, const MemoryAccess& access,
+                      uint32_t storeData) const;
     void logRace(const Race& race) const;
+    void mergeRanges(AccessMap& accesses, size_t begin, size_t end) const;
+    void mergeShadow(ShadowPage *page, size_t address, size_t offset,
+                     const AccessRecord& record, const uint8_t *storeData,
+                     unsigned size, size_t group);
+    void releaseShadow(GlobalBufferState *state) const;
+    void splitRange(AccessMap& accesses, size_t address) const;
     void registerAccess(const Memory *memory,
                         const WorkGroup *workGroup,
                         const WorkItem *workItem,
@@ -42,7 +42,7 @@ static std::mutex atomicShadowMutex[NUM_ATOMIC_MUTEXES];
 THREAD_LOCAL ShadowContext::WorkSpace ShadowContext::m_workSpace = {NULL, NULL, NULL, 0};
 
 Uninitialized::Uninitialized(const Context *context)
- : Plugin(context), shadowContext(sizeof(size_t)==8 ? 32 : 16)
+ : Plugin(context), shadowContext(sizeof(size_t)==8 ? 32 : 16, getIndex())
 {
     shadowContext.createMemoryPool();
 }
@@ -1914,6 +1914,25 @@ void Uninitialized::memoryMap(const Memory *memory, size_t address,
     }
 }
 
+bool Uninitialized::needsEvent(Event event) const
+{
+    switch (event)
+    {
+    case EventHostMemoryStore:
+    case EventInstructionExecuted:
+    case EventKernelBegin:
+    case EventKernelEnd:
+    case EventMemoryMap:
+    case EventWorkGroupBegin:
+    case EventWorkGroupComplete:
+    case EventWorkItemBegin:
+    case EventWorkItemComplete:
+        return true;
+    default:
+        return false;
+    }
+}
+
 void Uninitialized::VectorOr(const WorkItem *workItem, const llvm::Instruction *I)
 {
     PARANOID_CHECK(workItem, I);
@@ -2418,8 +2437,9 @@ void ShadowMemory::unlock(size_t address) const
     ATOMIC_MUTEX(offset).unlock();
 }
 
-ShadowContext::ShadowContext(unsigned bufferBits) :
-    m_globalMemory(new ShadowMemory(AddrSpaceGlobal, bufferBits)), m_globalValues(), m_numBitsBuffer(bufferBits)
+ShadowContext::ShadowContext(unsigned bufferBits, unsigned pluginIndex) :
+    m_globalMemory(new ShadowMemory(AddrSpaceGlobal, bufferBits)), m_globalValues(), m_numBitsBuffer(bufferBits),
+    m_pluginIndex(pluginIndex)
 {
 }
 
@@ -2464,6 +2484,7 @@ ShadowWorkItem* ShadowContext::createShadowWorkItem(const WorkItem *workItem)
     assert(!m_workSpace.workItems->count(workItem) && "Workitems may only have one shadow");
     ShadowWorkItem *sWI = new ShadowWorkItem(m_numBitsBuffer);
     (*m_workSpace.workItems)[workItem] = sWI;
+    workItem->setPluginData(m_pluginIndex, sWI);
     return sWI;
 }
 
@@ -2472,6 +2493,7 @@ ShadowWorkGroup* ShadowContext::createShadowWorkGroup(const WorkGroup *workGroup
     assert(!m_workSpace.workGroups->count(workGroup) && "Workgroups may only have one shadow");
     ShadowWorkGroup *sWG = new ShadowWorkGroup(m_numBitsBuffer);
     (*m_workSpace.workGroups)[workGroup] = sWG;
+    workGroup->setPluginData(m_pluginIndex, sWG);
     return sWG;
 }
 
@@ -2490,6 +2512,7 @@ void ShadowContext::destroyShadowWorkItem(const WorkItem *workItem)
     assert(m_workSpace.workItems->count(workItem) && "No shadow for workitem found!");
     delete (*m_workSpace.workItems)[workItem];
     m_workSpace.workItems->erase(workItem);
+    workItem->setPluginData(m_pluginIndex, NULL);
 }
 
 void ShadowContext::destroyShadowWorkGroup(const WorkGroup *workGroup)
@@ -2497,6 +2520,7 @@ void ShadowContext::destroyShadowWorkGroup(const WorkGroup *workGroup)
     assert(m_workSpace.workGroups->count(workGroup) && "No shadow for workgroup found!");
     delete (*m_workSpace.workGroups)[workGroup];
     m_workSpace.workGroups->erase(workGroup);
+    workGroup->setPluginData(m_pluginIndex, NULL);
 }
 
 void ShadowContext::dump(const WorkItem *workItem) const
@@ -2674,6 +2698,16 @@ TypedValue ShadowContext::getPoisonedValue(const llvm::Type *Ty)
     return v;
 }
 
+ShadowWorkItem* ShadowContext::getShadowWorkItem(const WorkItem *workItem) const
+{
+    return (ShadowWorkItem*)workItem->getPluginData(m_pluginIndex);
+}
+
+ShadowWorkGroup* ShadowContext::getShadowWorkGroup(const WorkGroup *workGroup) const
+{
+    return (ShadowWorkGroup*)workGroup->getPluginData(m_pluginIndex);
+}
+
 TypedValue ShadowContext::getValue(const WorkItem *workItem, const llvm::Value *V) const
 {
     if(m_globalValues.count(V))
@@ -2687,6 +2721,11 @@ TypedValue ShadowContext::getValue(const WorkItem *workItem, const llvm::Value *
     }
 }
 
+bool ShadowContext::hasValue(const WorkItem *workItem, const llvm::Value* V) const
+{
+    return llvm::isa<llvm::Constant>(V) || m_globalValues.count(V) || getShadowWorkItem(workItem)->getValues()->hasValue(V);
+}
+
 bool ShadowContext::isCleanImage(const TypedValue shadowImage)
 {
     return (isCleanImageAddress(shadowImage) &&
@@ -182,7 +182,7 @@ namespace oclgrind
     class ShadowContext
     {
         public:
-            ShadowContext(unsigned bufferBits);
+            ShadowContext(unsigned bufferBits, unsigned pluginIndex);
             virtual ~ShadowContext();
 
             void allocateWorkItems();
@@ -215,19 +215,10 @@ namespace oclgrind
             static TypedValue getPoisonedValue(TypedValue v);
             static TypedValue getPoisonedValue(const llvm::Type *Ty);
             static TypedValue getPoisonedValue(const llvm::Value *V);
-            inline ShadowWorkItem* getShadowWorkItem(const WorkItem *workItem) const
-            {
-                return m_workSpace.workItems->at(workItem);
-            }
-            inline ShadowWorkGroup* getShadowWorkGroup(const WorkGroup *workGroup) const
-            {
-                return m_workSpace.workGroups->at(workGroup);
-            }
+            ShadowWorkItem* getShadowWorkItem(const WorkItem *workItem) const;
+            ShadowWorkGroup* getShadowWorkGroup(const WorkGroup *workGroup) const;
             TypedValue getValue(const WorkItem *workItem, const llvm::Value *V) const;
-            inline bool hasValue(const WorkItem *workItem, const llvm::Value* V) const
-            {
-                return llvm::isa<llvm::Constant>(V) || m_globalValues.count(V) || m_workSpace.workItems->at(workItem)->getValues()->hasValue(V);
-            }
+            bool hasValue(const WorkItem *workItem, const llvm::Value* V) const;
             static bool isCleanImage(const TypedValue shadowImage);
             static bool isCleanImageAddress(const TypedValue shadowImage);
             static bool isCleanImageDescription(const TypedValue shadowImage);
@@ -243,6 +234,9 @@ namespace oclgrind
             ShadowMemory *m_globalMemory;
             UnorderedTypedValueMap m_globalValues;
             unsigned m_numBitsBuffer;
+            // Shadows are attached to work-items and work-groups through
+            // the plugin's data slots, and also recorded here for dumping
+            unsigned m_pluginIndex;
             typedef std::map<const WorkItem*, ShadowWorkItem*> ShadowItemMap;
             typedef std::map<const WorkGroup*, ShadowWorkGroup*> ShadowGroupMap;
             struct WorkSpace
@@ -275,6 +269,7 @@ namespace oclgrind
             virtual void workItemComplete(const WorkItem *workItem) override;
             virtual void workGroupBegin(const WorkGroup *workGroup) override;
             virtual void workGroupComplete(const WorkGroup *workGroup) override;
+            virtual bool needsEvent(Event event) const override;
             //virtual void memoryAllocated(const Memory *memory, size_t address,
             //                             size_t size, cl_mem_flags flags,
             //                             const uint8_t *initData);
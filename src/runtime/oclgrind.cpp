@@ -199,7 +199,11 @@ static bool parseArguments(int argc, char *argv[])
 {
   for (int i = 1; i < argc; i++)
   {
-    if (!strcmp(argv[i], "--build-options"))
+    if (!strcmp(argv[i], "--async-plugins"))
+    {
+      setEnvironment("OCLGRIND_ASYNC_PLUGINS", "1");
+    }
+    else if (!strcmp(argv[i], "--build-options"))
     {
       if (++i >= argc)
       {
@@ -242,6 +246,24 @@ static bool parseArguments(int argc, char *argv[])
     {
       setEnvironment("OCLGRIND_DUMP_SPIR", "1");
     }
+    else if (!strcmp(argv[i], "--file-threshold"))
+    {
+      if (++i >= argc)
+      {
+        cerr << "Missing argument to --file-threshold" << endl;
+        return false;
+      }
+      setEnvironment("OCLGRIND_FILE_THRESHOLD", argv[i]);
+    }
+    else if (!strcmp(argv[i], "--global-mem-dir"))
+    {
+      if (++i >= argc)
+      {
+        cerr << "Missing argument to --global-mem-dir" << endl;
+        return false;
+      }
+      setEnvironment("OCLGRIND_GLOBAL_MEM_DIR", argv[i]);
+    }
     else if (!strcmp(argv[i], "--global-mem-size"))
     {
       if (++i >= argc)
@@ -331,6 +353,32 @@ static bool parseArguments(int argc, char *argv[])
     {
       setEnvironment("OCLGRIND_QUICK", "1");
     }
+    else if (!strcmp(argv[i], "--replay"))
+    {
+      setEnvironment("OCLGRIND_REPLAY", "1");
+    }
+    else if (!strcmp(argv[i], "--sample"))
+    {
+      if (++i >= argc)
+      {
+        cerr << "Missing argument to --sample" << endl;
+        return false;
+      }
+      setEnvironment("OCLGRIND_SAMPLE", argv[i]);
+    }
+    else if (!strcmp(argv[i], "--sample-seed"))
+    {
+      if (++i >= argc)
+      {
+        cerr << "Missing argument to --sample-seed" << endl;
+        return false;
+      }
+      setEnvironment("OCLGRIND_SAMPLE_SEED", argv[i]);
+    }
+    else if (!strcmp(argv[i], "--sample-uninstrumented"))
+    {
+      setEnvironment("OCLGRIND_SAMPLE_UNINSTRUMENTED", "1");
+    }
     else if (!strcmp(argv[i], "--uniform-writes"))
     {
       setEnvironment("OCLGRIND_UNIFORM_WRITES", "1");
@@ -458,6 +506,8 @@ static void printUsage()
     << "       oclgrind [--help | --version]" << endl
     << endl
     << "Options:" << endl
+    << "  --async-plugins              "
+          "Run supporting plugins on analysis threads" << endl
     << "  --build-options     OPTIONS  "
           "Additional options to pass to the OpenCL compiler" << endl
     << "  --check-api                  "
@@ -472,6 +522,10 @@ static void printUsage()
           "Don't use precompiled headers" << endl
     << "  --dump-spir                  "
           "Dump SPIR to /tmp/oclgrind_*.{ll,bc}" << endl
+    << "  --file-threshold    BYTES    "
+          "Minimum size of file-backed buffers (default 64MB)" << endl
+    << "  --global-mem-dir    DIR      "
+          "Back large global memory buffers with files in DIR" << endl
     << "  --global-mem-size   BYTES    "
           "Change the global memory size of the device" << endl
     << "  --help [-h]                  "
@@ -496,6 +550,16 @@ static void printUsage()
           "Load colon separated list of plugin libraries" << endl
     << "  --quick [-q]                 "
           "Only run first and last work-group" << endl
+    << "  --replay                     "
+          "Only run plugins on work-groups that raise errors" << endl
+    << "                               "
+          "(outputs of other work-groups count as initialized)" << endl
+    << "  --sample            NUM      "
+          "Only run a count or fraction of work-groups" << endl
+    << "  --sample-seed       SEED     "
+          "Seed used to choose sampled work-groups" << endl
+    << "  --sample-uninstrumented      "
+          "Run other work-groups without plugins" << endl
     << "  --uniform-writes             "
           "Don't suppress uniform write-write data-races" << endl
     << "  --uninitialized              "
@@ -0,0 +1,144 @@
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+
+void scalar_ops(global half *a, global half *b,
+                global half *r, global short *cmp, int offset)
+{
+  half x = a[offset];
+  half y = b[offset];
+  half n = (y - y) / (y - y);
+
+  r[0 + offset] = x + y;
+  r[28 + offset] = x - y;
+  r[56 + offset] = x * y;
+  r[84 + offset] = x / y;
+  r[112 + offset] = -x;
+
+  cmp[0 + offset] = (x == y) |
+                    (x != y) << 1 |
+                    (x > y) << 2 |
+                    (x >= y) << 3 |
+                    (x < y) << 4 |
+                    (x <= y) << 5 |
+                    !(x < y) << 6 |
+                    !(x > y) << 7;
+
+  cmp[28 + offset] = (x == n) |
+                     (x != n) << 1 |
+                     (x > n) << 2 |
+                     (x >= n) << 3 |
+                     (x < n) << 4 |
+                     (x <= n) << 5 |
+                     !(x < n) << 6 |
+                     !(x > n) << 7;
+}
+
+void half3_ops(global half *a, global half *b,
+               global half *r, global short *cmp, int offset)
+{
+  half3 x = vload3(0, a + offset);
+  half3 y = vload3(0, b + offset);
+  half3 n = (y - y) / (y - y);
+
+  vstore3(x + y, 0, r + 0 + offset);
+  vstore3(x - y, 0, r + 28 + offset);
+  vstore3(x * y, 0, r + 56 + offset);
+  vstore3(x / y, 0, r + 84 + offset);
+  vstore3(-x, 0, r + 112 + offset);
+
+  short3 mask = (x == y) & 1;
+  mask |= (x != y) & 2;
+  mask |= (x > y) & 4;
+  mask |= (x >= y) & 8;
+  mask |= (x < y) & 16;
+  mask |= (x <= y) & 32;
+  mask |= !(x < y) & 64;
+  mask |= !(x > y) & 128;
+  vstore3(mask, 0, cmp + 0 + offset);
+
+  mask = (x == n) & 1;
+  mask |= (x != n) & 2;
+  mask |= (x > n) & 4;
+  mask |= (x >= n) & 8;
+  mask |= (x < n) & 16;
+  mask |= (x <= n) & 32;
+  mask |= !(x < n) & 64;
+  mask |= !(x > n) & 128;
+  vstore3(mask, 0, cmp + 28 + offset);
+}
+
+void half8_ops(global half *a, global half *b,
+               global half *r, global short *cmp, int offset)
+{
+  half8 x = vload8(0, a + offset);
+  half8 y = vload8(0, b + offset);
+  half8 n = (y - y) / (y - y);
+
+  vstore8(x + y, 0, r + 0 + offset);
+  vstore8(x - y, 0, r + 28 + offset);
+  vstore8(x * y, 0, r + 56 + offset);
+  vstore8(x / y, 0, r + 84 + offset);
+  vstore8(-x, 0, r + 112 + offset);
+
+  short8 mask = (x == y) & 1;
+  mask |= (x != y) & 2;
+  mask |= (x > y) & 4;
+  mask |= (x >= y) & 8;
+  mask |= (x < y) & 16;
+  mask |= (x <= y) & 32;
+  mask |= !(x < y) & 64;
+  mask |= !(x > y) & 128;
+  vstore8(mask, 0, cmp + 0 + offset);
+
+  mask = (x == n) & 1;
+  mask |= (x != n) & 2;
+  mask |= (x > n) & 4;
+  mask |= (x >= n) & 8;
+  mask |= (x < n) & 16;
+  mask |= (x <= n) & 32;
+  mask |= !(x < n) & 64;
+  mask |= !(x > n) & 128;
+  vstore8(mask, 0, cmp + 28 + offset);
+}
+
+void half16_ops(global half *a, global half *b,
+                global half *r, global short *cmp, int offset)
+{
+  half16 x = vload16(0, a + offset);
+  half16 y = vload16(0, b + offset);
+  half16 n = (y - y) / (y - y);
+
+  vstore16(x + y, 0, r + 0 + offset);
+  vstore16(x - y, 0, r + 28 + offset);
+  vstore16(x * y, 0, r + 56 + offset);
+  vstore16(x / y, 0, r + 84 + offset);
+  vstore16(-x, 0, r + 112 + offset);
+
+  short16 mask = (x == y) & 1;
+  mask |= (x != y) & 2;
+  mask |= (x > y) & 4;
+  mask |= (x >= y) & 8;
+  mask |= (x < y) & 16;
+  mask |= (x <= y) & 32;
+  mask |= !(x < y) & 64;
+  mask |= !(x > y) & 128;
+  vstore16(mask, 0, cmp + 0 + offset);
+
+  mask = (x == n) & 1;
+  mask |= (x != n) & 2;
+  mask |= (x > n) & 4;
+  mask |= (x >= n) & 8;
+  mask |= (x < n) & 16;
+  mask |= (x <= n) & 32;
+  mask |= !(x < n) & 64;
+  mask |= !(x > n) & 128;
+  vstore16(mask, 0, cmp + 28 + offset);
+}
+
+kernel void half_ops(global half *a, global half *b,
+                     global half *r, global short *cmp)
+{
+  scalar_ops(a, b, r, cmp, 0);
+  half3_ops(a, b, r, cmp, 1);
+  half8_ops(a, b, r, cmp, 4);
+  half16_ops(a, b, r, cmp, 12);
+}
@@ -0,0 +1,53 @@
+kernel void vector16_ops(global char *a, global char *b,
+                         global char *r, global int *icmp,
+                         global float *fa, global float *fb,
+                         global float *fr, global int *fcmp)
+{
+  char16 x = vload16(0, a);
+  char16 y = vload16(0, b);
+  uchar16 ux = as_uchar16(x);
+  uchar16 uy = as_uchar16(y);
+
+  vstore16(x + y, 0, r);
+  vstore16(x - y, 1, r);
+  vstore16(x * y, 2, r);
+  vstore16(x & y, 3, r);
+  vstore16(x | y, 4, r);
+  vstore16(x ^ y, 5, r);
+
+  int16 mask = convert_int16(x == y) & 1;
+  mask |= convert_int16(x != y) & 2;
+  mask |= convert_int16(x > y) & 4;
+  mask |= convert_int16(x >= y) & 8;
+  mask |= convert_int16(x < y) & 16;
+  mask |= convert_int16(x <= y) & 32;
+  mask |= convert_int16(ux > uy) & 64;
+  mask |= convert_int16(ux >= uy) & 128;
+  mask |= convert_int16(ux < uy) & 256;
+  mask |= convert_int16(ux <= uy) & 512;
+  vstore16(mask, 0, icmp);
+
+  float16 fx = vload16(0, fa);
+  float16 fy = vload16(0, fb);
+  float16 fn = (fy - fy) / (fy - fy);
+
+  vstore16(fx + fy, 0, fr);
+  vstore16(fx - fy, 1, fr);
+  vstore16(fx * fy, 2, fr);
+  vstore16(fx / fy, 3, fr);
+
+  int16 fmask = convert_int16(fx == fy) & 1;
+  fmask |= convert_int16(fx != fy) & 2;
+  fmask |= convert_int16(fx > fy) & 4;
+  fmask |= convert_int16(fx >= fy) & 8;
+  fmask |= convert_int16(fx < fy) & 16;
+  fmask |= convert_int16(fx <= fy) & 32;
+  vstore16(fmask, 0, fcmp);
+  fmask = convert_int16(fx == fn) & 1;
+  fmask |= convert_int16(fx != fn) & 2;
+  fmask |= convert_int16(fx > fn) & 4;
+  fmask |= convert_int16(fx >= fn) & 8;
+  fmask |= convert_int16(fx < fn) & 16;
+  fmask |= convert_int16(fx <= fn) & 32;
+  vstore16(fmask, 1, fcmp);
+}
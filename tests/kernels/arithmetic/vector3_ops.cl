@@ -0,0 +1,53 @@
+kernel void vector3_ops(global int *a, global int *b,
+                        global int *r, global int *icmp,
+                        global float *fa, global float *fb,
+                        global float *fr, global int *fcmp)
+{
+  int3 x = vload3(0, a);
+  int3 y = vload3(0, b);
+  uint3 ux = as_uint3(x);
+  uint3 uy = as_uint3(y);
+
+  vstore3(x + y, 0, r);
+  vstore3(x - y, 1, r);
+  vstore3(x * y, 2, r);
+  vstore3(x & y, 3, r);
+  vstore3(x | y, 4, r);
+  vstore3(x ^ y, 5, r);
+
+  int3 mask = convert_int3(x == y) & 1;
+  mask |= convert_int3(x != y) & 2;
+  mask |= convert_int3(x > y) & 4;
+  mask |= convert_int3(x >= y) & 8;
+  mask |= convert_int3(x < y) & 16;
+  mask |= convert_int3(x <= y) & 32;
+  mask |= convert_int3(ux > uy) & 64;
+  mask |= convert_int3(ux >= uy) & 128;
+  mask |= convert_int3(ux < uy) & 256;
+  mask |= convert_int3(ux <= uy) & 512;
+  vstore3(mask, 0, icmp);
+
+  float3 fx = vload3(0, fa);
+  float3 fy = vload3(0, fb);
+  float3 fn = (fy - fy) / (fy - fy);
+
+  vstore3(fx + fy, 0, fr);
+  vstore3(fx - fy, 1, fr);
+  vstore3(fx * fy, 2, fr);
+  vstore3(fx / fy, 3, fr);
+
+  int3 fmask = convert_int3(fx == fy) & 1;
+  fmask |= convert_int3(fx != fy) & 2;
+  fmask |= convert_int3(fx > fy) & 4;
+  fmask |= convert_int3(fx >= fy) & 8;
+  fmask |= convert_int3(fx < fy) & 16;
+  fmask |= convert_int3(fx <= fy) & 32;
+  vstore3(fmask, 0, fcmp);
+  fmask = convert_int3(fx == fn) & 1;
+  fmask |= convert_int3(fx != fn) & 2;
+  fmask |= convert_int3(fx > fn) & 4;
+  fmask |= convert_int3(fx >= fn) & 8;
+  fmask |= convert_int3(fx < fn) & 16;
+  fmask |= convert_int3(fx <= fn) & 32;
+  vstore3(fmask, 1, fcmp);
+}
@@ -0,0 +1,53 @@
+kernel void vector8_ops(global short *a, global short *b,
+                        global short *r, global int *icmp,
+                        global double *fa, global double *fb,
+                        global double *fr, global int *fcmp)
+{
+  short8 x = vload8(0, a);
+  short8 y = vload8(0, b);
+  ushort8 ux = as_ushort8(x);
+  ushort8 uy = as_ushort8(y);
+
+  vstore8(x + y, 0, r);
+  vstore8(x - y, 1, r);
+  vstore8(x * y, 2, r);
+  vstore8(x & y, 3, r);
+  vstore8(x | y, 4, r);
+  vstore8(x ^ y, 5, r);
+
+  int8 mask = convert_int8(x == y) & 1;
+  mask |= convert_int8(x != y) & 2;
+  mask |= convert_int8(x > y) & 4;
+  mask |= convert_int8(x >= y) & 8;
+  mask |= convert_int8(x < y) & 16;
+  mask |= convert_int8(x <= y) & 32;
+  mask |= convert_int8(ux > uy) & 64;
+  mask |= convert_int8(ux >= uy) & 128;
+  mask |= convert_int8(ux < uy) & 256;
+  mask |= convert_int8(ux <= uy) & 512;
+  vstore8(mask, 0, icmp);
+
+  double8 fx = vload8(0, fa);
+  double8 fy = vload8(0, fb);
+  double8 fn = (fy - fy) / (fy - fy);
+
+  vstore8(fx + fy, 0, fr);
+  vstore8(fx - fy, 1, fr);
+  vstore8(fx * fy, 2, fr);
+  vstore8(fx / fy, 3, fr);
+
+  int8 fmask = convert_int8(fx == fy) & 1;
+  fmask |= convert_int8(fx != fy) & 2;
+  fmask |= convert_int8(fx > fy) & 4;
+  fmask |= convert_int8(fx >= fy) & 8;
+  fmask |= convert_int8(fx < fy) & 16;
+  fmask |= convert_int8(fx <= fy) & 32;
+  vstore8(fmask, 0, fcmp);
+  fmask = convert_int8(fx == fn) & 1;
+  fmask |= convert_int8(fx != fn) & 2;
+  fmask |= convert_int8(fx > fn) & 4;
+  fmask |= convert_int8(fx >= fn) & 8;
+  fmask |= convert_int8(fx < fn) & 16;
+  fmask |= convert_int8(fx <= fn) & 32;
+  vstore8(fmask, 1, fcmp);
+}
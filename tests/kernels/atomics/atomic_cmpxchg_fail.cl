@@ -0,0 +1,16 @@
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+
+kernel void atomic_cmpxchg_fail(global int *data, global long *ldata,
+                                global int *out, global long *lout)
+{
+  int i = get_global_id(0);
+
+  // Compare never matches, so memory must be left unchanged
+  out[i] = atomic_cmpxchg(data, -1, i);
+
+  // Only the first work-item matches
+  out[i+4] = atomic_cmpxchg(data+1, 0, i+1);
+
+  // Low 32 bits match but high bits do not
+  lout[i] = atom_cmpxchg(ldata, 0, i);
+}
@@ -0,0 +1,27 @@
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+#pragma OPENCL EXTENSION cl_khr_int64_extended_atomics : enable
+
+kernel void atomic_global_aligned(global int *data, global uint *udata,
+                                  global long *ldata)
+{
+  int i = get_global_id(0);
+
+  atomic_add(data, 1);
+  atomic_sub(data+1, 2);
+  atomic_inc(data+2);
+  atomic_dec(data+3);
+  atomic_min(data+4, i - 10);
+  atomic_max(data+5, i);
+  atomic_or(data+6, 1 << (i % 32));
+  atomic_xor(data+7, 1 << (i % 32));
+  atomic_and(data+8, ~(1 << (i % 16)));
+
+  atomic_min(udata, i + 5);
+  atomic_max(udata+1, 0xFFFFFFF0 + (i % 16));
+
+  atom_add(ldata, 0x100000001);
+  atom_inc(ldata+1);
+  atom_min(ldata+2, i - 10);
+  atom_max(ldata+3, (long)i << 32);
+  atom_xor(ldata+4, (long)1 << (i % 64));
+}
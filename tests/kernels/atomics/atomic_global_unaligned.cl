@@ -0,0 +1,7 @@
+#pragma OPENCL EXTENSION cl_khr_int64_base_atomics : enable
+
+kernel void atomic_global_unaligned(global uchar *data)
+{
+  atomic_add((global int*)(data+2), 0x01020304);
+  atom_add((global ulong*)(data+12), 0x0102030405060708);
+}
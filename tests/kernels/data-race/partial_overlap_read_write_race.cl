@@ -0,0 +1,12 @@
+kernel void partial_overlap_read_write_race(global int *data)
+{
+  int i = get_global_id(0);
+  if (i == 0)
+  {
+    vstore2((int2)(1, 2), 0, data);
+  }
+  else if (i == 1)
+  {
+    data[3] = vload2(0, data + 1).x;
+  }
+}
@@ -0,0 +1,5 @@
+kernel void partial_overlap_uniform_write_race(global int *data)
+{
+  int i = get_global_id(0);
+  vstore2((int2)(7, i), 0, data + i);
+}
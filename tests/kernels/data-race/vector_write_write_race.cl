@@ -0,0 +1,5 @@
+kernel void vector_write_write_race(global int *data)
+{
+  int i = get_global_id(0);
+  vstore4((int4)(i), 0, data + i*2);
+}
@@ -0,0 +1,14 @@
+kernel void global_mem_file(global int *input, global int *output,
+                            global int *sum)
+{
+  int i = get_global_id(0);
+
+  // Each work-item streams through its own contiguous block
+  int total = 0;
+  for (int j = i*256; j < (i+1)*256; j++)
+  {
+    output[j] = input[j] * 2;
+    total += output[j];
+  }
+  sum[i] = total;
+}
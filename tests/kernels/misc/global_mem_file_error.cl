@@ -0,0 +1,5 @@
+kernel void global_mem_file_error(global int *input, global int *output)
+{
+  int i = get_global_id(0);
+  output[i] = input[i] + 1;
+}
@@ -0,0 +1,12 @@
+kernel void replay_flagged_group(global int *data, global int *out)
+{
+  int i = get_global_id(0);
+  int v = data[i];
+  data[i] = v + 1;
+
+  // Only the original input value leads to an invalid write
+  if (v < 7)
+    out[i] = v;
+  else if (v == 7)
+    out[v] = v;
+}
@@ -0,0 +1,7 @@
+kernel void sample_uninstrumented(global int *data, local int *scratch)
+{
+  int i = get_global_id(0);
+  *scratch = i;
+  barrier(CLK_LOCAL_MEM_FENCE);
+  data[i] = *scratch;
+}
@@ -0,0 +1,71 @@
+# run_async_test.py (Oclgrind)
+# Copyright (c) 2013-2019, James Price and Simon McIntosh-Smith,
+# University of Bristol. All rights reserved.
+#
+# This program is provided under a three-clause BSD license. For full
+# license terms please see the LICENSE file distributed with this
+# source code.
+
+# Check that plugins report the same results when their events are
+# delivered asynchronously as when they are delivered synchronously
+
+import os
+import subprocess
+import sys
+
+# Check arguments
+if len(sys.argv) != 3:
+  print('Usage: python run_async_test.py OCLGRIND-KERNEL TEST.sim')
+  sys.exit(1)
+if not os.path.isfile(sys.argv[2]):
+  print('Test file not found')
+  sys.exit(1)
+
+oclgrind_exe = sys.argv[1]
+test_dir     = os.path.dirname(os.path.realpath(sys.argv[2]))
+test_file    = os.path.basename(sys.argv[2])
+
+# Use several workers, so that events arrive through several rings
+os.environ["OCLGRIND_NUM_THREADS"] = "4"
+
+def fail(ret=1):
+  print('FAILED')
+  sys.exit(ret)
+
+def run(args):
+  cmd = [oclgrind_exe, '--inst-counts'] + args + [test_file]
+  proc = subprocess.Popen(cmd, cwd=test_dir,
+                          stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+  out = proc.communicate()[0].decode()
+  if proc.returncode != 0:
+    print(out)
+    print('Test returned non-zero value (' + str(proc.returncode) + ')')
+    fail(proc.returncode)
+
+  # Scheduling statistics vary between runs
+  return [line for line in out.splitlines()
+          if not line.startswith('Scheduled ')]
+
+def compare():
+  sync_out = run([])
+  async_out = run(['--async-plugins'])
+  for i in range(max(len(sync_out), len(async_out))):
+    expected = sync_out[i] if i < len(sync_out) else ''
+    found = async_out[i] if i < len(async_out) else ''
+    if expected != found:
+      print('Expected "' + expected + '"')
+      print('Found    "' + found + '"')
+      fail()
+
+print('Running test with optimisations')
+compare()
+print('PASSED')
+
+print('')
+print('Running test without optimisations')
+os.environ["OCLGRIND_BUILD_OPTIONS"] = "-cl-opt-disable"
+compare()
+print('PASSED')
+
+# Test passed
+sys.exit(0)
@@ -0,0 +1,100 @@
+#include "common.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define N 8
+#define LOCAL_SIZE 4
+
+// The second work-group of 'produce' raises an error, so only that
+// work-group is replayed with plugins attached. The results written by the
+// first work-group must still count as initialized when 'consume' reads them.
+const char *KERNEL_SOURCE =
+"kernel void produce(global int *out)                        \n"
+"{                                                           \n"
+"  int i = get_global_id(0);                                 \n"
+"  out[i] = i;                                               \n"
+"  if (i == 5)                                               \n"
+"    out[get_global_size(0)] = i;                            \n"
+"}                                                           \n"
+"                                                            \n"
+"kernel void consume(global int *out, global int *result)    \n"
+"{                                                           \n"
+"  int i = get_global_id(0);                                 \n"
+"  if (out[i] == i)                                          \n"
+"    result[i] = 1;                                          \n"
+"  else                                                      \n"
+"    result[i] = 0;                                          \n"
+"}                                                           \n"
+;
+
+static void setEnvironment(const char *name, const char *value)
+{
+#if defined(_WIN32) && !defined(__MINGW32__)
+  _putenv_s(name, value);
+#else
+  setenv(name, value, 1);
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+  cl_int err;
+  cl_kernel produce, consume;
+  cl_mem d_out, d_result;
+
+  setEnvironment("OCLGRIND_REPLAY", "1");
+
+  Context cl = createContext(KERNEL_SOURCE, "");
+
+  produce = clCreateKernel(cl.program, "produce", &err);
+  checkError(err, "creating produce kernel");
+  consume = clCreateKernel(cl.program, "consume", &err);
+  checkError(err, "creating consume kernel");
+
+  d_out = clCreateBuffer(cl.context, CL_MEM_READ_WRITE, N*sizeof(cl_int),
+                         NULL, &err);
+  checkError(err, "creating d_out buffer");
+  d_result = clCreateBuffer(cl.context, CL_MEM_WRITE_ONLY, N*sizeof(cl_int),
+                            NULL, &err);
+  checkError(err, "creating d_result buffer");
+
+  err  = clSetKernelArg(produce, 0, sizeof(cl_mem), &d_out);
+  err |= clSetKernelArg(consume, 0, sizeof(cl_mem), &d_out);
+  err |= clSetKernelArg(consume, 1, sizeof(cl_mem), &d_result);
+  checkError(err, "setting kernel args");
+
+  size_t global = N;
+  size_t local = LOCAL_SIZE;
+  err = clEnqueueNDRangeKernel(cl.queue, produce,
+                               1, NULL, &global, &local, 0, NULL, NULL);
+  checkError(err, "enqueuing produce kernel");
+  err = clEnqueueNDRangeKernel(cl.queue, consume,
+                               1, NULL, &global, &local, 0, NULL, NULL);
+  checkError(err, "enqueuing consume kernel");
+
+  cl_int h_result[N];
+  err = clEnqueueReadBuffer(cl.queue, d_result, CL_TRUE, 0, N*sizeof(cl_int),
+                            h_result, 0, NULL, NULL);
+  checkError(err, "reading d_result buffer");
+
+  unsigned errors = 0;
+  for (unsigned i = 0; i < N; i++)
+  {
+    if (h_result[i] != 1)
+    {
+      fprintf(stderr, "%2u: %d != 1\n", i, h_result[i]);
+      errors++;
+    }
+  }
+
+  printf("%d errors detected\n", errors);
+
+  clReleaseMemObject(d_out);
+  clReleaseMemObject(d_result);
+  clReleaseKernel(produce);
+  clReleaseKernel(consume);
+  releaseContext(cl);
+
+  return (errors != 0);
+}